@@ -0,0 +1,82 @@
+#ifndef APP_METRICS_H
+#define APP_METRICS_H
+
+#include <cstdint>
+#include <vector>
+
+// IPv4 and UDP headers of every packet, included in the byte counts like in FlowMonitor
+const uint32_t IP_UDP_HEADER_SIZE = 28;
+
+// Traffic of a station counted by its source and its sink
+struct FlowCounters
+{
+  uint64_t txPackets = 0;
+  uint64_t txBytes = 0;
+  uint64_t rxPackets = 0;
+  uint64_t rxBytes = 0;
+  uint64_t lostPackets = 0;   // sequence numbers skipped at the sink
+  double delaySum = 0.;       // s
+};
+
+/*
+ * Per-station throughput, loss and delay of the traffic applications, from the SeqTsSizeHeader
+ * their packets carry. Unlike FlowMonitor, nothing is kept per packet: every send and receive
+ * updates the flat counters of the station in O(1). A packet is lost once the sink receives a
+ * later sequence number of the station, a late arrival of a packet counted as lost is taken back.
+ */
+class AppMetrics
+{
+public:
+  void
+  Resize (uint32_t nStations)
+  {
+    m_counters.assign (nStations, FlowCounters ());
+    m_nextSeq.assign (nStations, 0);
+  }
+
+  void
+  RecordTx (uint32_t station, uint32_t size)
+  {
+    FlowCounters &counters = m_counters[station];
+    counters.txPackets++;
+    counters.txBytes += size + IP_UDP_HEADER_SIZE;
+  }
+
+  void
+  RecordRx (uint32_t station, uint32_t size, uint32_t seq, double delay)
+  {
+    FlowCounters &counters = m_counters[station];
+    counters.rxPackets++;
+    counters.rxBytes += size + IP_UDP_HEADER_SIZE;
+    counters.delaySum += delay;
+
+    if (seq >= m_nextSeq[station])
+      {
+        counters.lostPackets += seq - m_nextSeq[station];
+        m_nextSeq[station] = seq + 1;
+      }
+    else if (counters.lostPackets > 0)
+      {
+        counters.lostPackets--;
+      }
+  }
+
+  const std::vector<FlowCounters> &
+  GetAll () const
+  {
+    return m_counters;
+  }
+
+  // Restart the counters (e.g. at the warmup end), the sequence numbers of the sources go on
+  void
+  Reset ()
+  {
+    m_counters.assign (m_counters.size (), FlowCounters ());
+  }
+
+private:
+  std::vector<FlowCounters> m_counters;
+  std::vector<uint32_t> m_nextSeq;
+};
+
+#endif /* APP_METRICS_H */
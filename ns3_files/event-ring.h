@@ -0,0 +1,228 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ns3/abort.h"
+
+/*
+ * Frame-level events of a running simulation published in a POSIX shared memory ring
+ * (/dev/shm/<name>) for external consumers (see python/envs/event_ring.py).
+ *
+ * The simulation is the only producer. A push copies one fixed-size record into the ring
+ * and publishes it with a release store of the write index, with no locks, syscalls or
+ * allocation. Every consumer owns a slot in the header with its read index. If the
+ * slowest consumer is a full ring behind, the record is dropped and counted in the
+ * overflow counter, so the simulation never waits for a consumer. Without consumers the
+ * ring is simply overwritten.
+ *
+ * A consumer joins by storing an all-ones read index and its pid in a free slot, and only
+ * then sets its read index to the write index. The producer may have cached a read index
+ * from before the slot became active, but never one past that write index.
+ *
+ * Layout (little-endian, offsets in bytes):
+ *   0    magic "CWEV", version, record size, capacity (uint32 each)
+ *   64   write index (uint64, records pushed so far)
+ *   128  overflow (uint64, records dropped)
+ *   192  MAX_CONSUMERS slots of 64 B: read index (uint64), pid (int32, 0 - free)
+ *   448  capacity records, record i at slot i % capacity
+ */
+
+enum EventType : uint8_t
+{
+  EVENT_TX = 0,
+  EVENT_RETRY = 1,
+  EVENT_DROP = 2,
+  EVENT_RX = 3
+};
+
+#pragma pack(push, 1)
+struct EventRecord
+{
+  double time;        // s
+  uint32_t station;   // device index (0 - AP)
+  uint8_t type;       // EventType
+  uint8_t mcs;
+  uint16_t cw;
+  uint32_t size;      // B
+  uint32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert (sizeof (EventRecord) == 24, "EventRecord layout is shared with the consumers");
+static_assert (std::atomic<uint64_t>::is_always_lock_free, "The ring needs lock-free 64-bit atomics");
+static_assert (std::atomic<int32_t>::is_always_lock_free, "The ring needs lock-free 32-bit atomics");
+
+const uint32_t EVENT_RING_VERSION = 1;
+const uint32_t EVENT_RING_MAX_CONSUMERS = 4;
+
+struct alignas (64) EventRingConsumer
+{
+  std::atomic<uint64_t> readIndex;
+  std::atomic<int32_t> pid;
+};
+
+struct EventRingHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t capacity;
+  alignas (64) std::atomic<uint64_t> writeIndex;
+  alignas (64) std::atomic<uint64_t> overflow;
+  EventRingConsumer consumers[EVENT_RING_MAX_CONSUMERS];
+};
+
+static_assert (offsetof (EventRingHeader, writeIndex) == 64, "EventRingHeader layout is shared with the consumers");
+static_assert (offsetof (EventRingHeader, overflow) == 128, "EventRingHeader layout is shared with the consumers");
+static_assert (offsetof (EventRingHeader, consumers) == 192, "EventRingHeader layout is shared with the consumers");
+static_assert (offsetof (EventRingConsumer, pid) == 8, "EventRingConsumer layout is shared with the consumers");
+static_assert (sizeof (EventRingHeader) == 448, "EventRingHeader layout is shared with the consumers");
+
+class EventRing
+{
+public:
+  ~EventRing ()
+  {
+    Close ();
+  }
+
+  // Capacity is rounded up to a power of two, so that the slot is a mask of the index
+  void
+  Open (std::string name, uint32_t capacity)
+  {
+    NS_ABORT_MSG_IF (capacity == 0, "Event ring capacity must be positive");
+    m_capacity = 1;
+    while (m_capacity < capacity)
+      {
+        m_capacity <<= 1;
+      }
+
+    m_name = name[0] == '/' ? name : "/" + name;
+    m_size = sizeof (EventRingHeader) + static_cast<size_t> (m_capacity) * sizeof (EventRecord);
+
+    shm_unlink (m_name.c_str ());
+    int fd = shm_open (m_name.c_str (), O_CREAT | O_EXCL | O_RDWR, 0644);
+    NS_ABORT_MSG_IF (fd < 0 || ftruncate (fd, m_size) < 0, "Cannot create event ring " << m_name);
+    void *memory = mmap (nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    NS_ABORT_MSG_IF (memory == MAP_FAILED, "Cannot map event ring " << m_name);
+
+    // ftruncate zero-fills the segment: indices, overflow and all consumer slots start at 0
+    m_header = new (memory) EventRingHeader;
+    m_records = reinterpret_cast<EventRecord *> (static_cast<char *> (memory) + sizeof (EventRingHeader));
+    m_header->version = EVENT_RING_VERSION;
+    m_header->recordSize = sizeof (EventRecord);
+    m_header->capacity = m_capacity;
+    m_write = 0;
+    m_cachedRead = 0;
+
+    // Consumers check the magic last, after the rest of the header is valid
+    std::atomic_thread_fence (std::memory_order_release);
+    std::memcpy (m_header->magic, "CWEV", 4);
+  }
+
+  void
+  Close ()
+  {
+    if (m_header == nullptr)
+      {
+        return;
+      }
+
+    munmap (m_header, m_size);
+    shm_unlink (m_name.c_str ());
+    m_header = nullptr;
+  }
+
+  bool
+  IsOpen () const
+  {
+    return m_header != nullptr;
+  }
+
+  // Returns false if the record was dropped because a consumer is a full ring behind
+  bool
+  Push (double time, uint32_t station, EventType type, uint8_t mcs, uint16_t cw, uint32_t size)
+  {
+    if (m_write - m_cachedRead >= m_capacity)
+      {
+        m_cachedRead = GetSlowestReader ();
+        if (m_write - m_cachedRead >= m_capacity)
+          {
+            m_header->overflow.store (m_header->overflow.load (std::memory_order_relaxed) + 1,
+                                      std::memory_order_relaxed);
+            return false;
+          }
+      }
+
+    m_records[m_write & (m_capacity - 1)] = {time, station, type, mcs, cw, size, 0};
+    m_header->writeIndex.store (++m_write, std::memory_order_release);
+    return true;
+  }
+
+  uint64_t
+  GetPushed () const
+  {
+    return m_write;
+  }
+
+  uint64_t
+  GetOverflow () const
+  {
+    return m_header->overflow.load (std::memory_order_relaxed);
+  }
+
+  // Free the slots of consumers that exited without releasing them, so that they do not stall the ring
+  void
+  PruneConsumers ()
+  {
+    for (EventRingConsumer &consumer : m_header->consumers)
+      {
+        int32_t pid = consumer.pid.load (std::memory_order_acquire);
+        if (pid != 0 && kill (pid, 0) < 0 && errno == ESRCH)
+          {
+            consumer.pid.compare_exchange_strong (pid, 0, std::memory_order_acq_rel);
+          }
+      }
+  }
+
+private:
+  // Read index of the slowest active consumer (the write index if there is none)
+  uint64_t
+  GetSlowestReader () const
+  {
+    uint64_t slowest = m_write;
+    for (const EventRingConsumer &consumer : m_header->consumers)
+      {
+        if (consumer.pid.load (std::memory_order_acquire) != 0)
+          {
+            uint64_t read = consumer.readIndex.load (std::memory_order_acquire);
+            slowest = read < slowest ? read : slowest;
+          }
+      }
+    return slowest;
+  }
+
+  std::string m_name;
+  size_t m_size = 0;
+  uint32_t m_capacity = 0;
+  EventRingHeader *m_header = nullptr;
+  EventRecord *m_records = nullptr;
+
+  // Producer-local copies, the shared write index is only stored
+  uint64_t m_write = 0;
+  uint64_t m_cachedRead = 0;
+};
+
+#endif /* EVENT_RING_H */
@@ -0,0 +1,95 @@
+#ifndef FROZEN_POLICY_H
+#define FROZEN_POLICY_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+
+/*
+ * Greedy actions of trained agents exported by python/envs/run.py (--exportPolicy), executed by
+ * the scenario itself, so that evaluation runs need no agents' process. The file is a CSV with
+ * a line per agent and the values of the sAct fields (-1 - dimension not controlled):
+ *   agent,cw,aifsn,txop,ampdu,rts
+ */
+
+const std::string FROZEN_POLICY_HEADER = "agent,cw,aifsn,txop,ampdu,rts";
+
+struct FrozenAction
+{
+  int cw = -1;            // CW index, CW = 2 ^ cw
+  int aifsn = -1;
+  int txopLimit = -1;     // us
+  int ampduSize = -1;     // B
+  int rtsThreshold = -1;  // B
+};
+
+class FrozenPolicy
+{
+public:
+  void
+  Load (std::string path)
+  {
+    std::ifstream file (path);
+    NS_ABORT_MSG_IF (!file, "Cannot open policy file " << path);
+
+    std::string line;
+    std::getline (file, line);
+    NS_ABORT_MSG_IF (line != FROZEN_POLICY_HEADER, "Policy file " << path << " does not start with " << FROZEN_POLICY_HEADER);
+    m_contents = line + "\n";
+
+    m_actions.clear ();
+    while (std::getline (file, line))
+      {
+        if (line.empty ())
+          {
+            continue;
+          }
+        m_contents += line + "\n";
+
+        std::istringstream fields (line);
+        int agent;
+        FrozenAction action;
+        char comma[5];
+        fields >> agent >> comma[0] >> action.cw >> comma[1] >> action.aifsn >> comma[2] >> action.txopLimit
+               >> comma[3] >> action.ampduSize >> comma[4] >> action.rtsThreshold;
+        NS_ABORT_MSG_IF (!fields || agent != (int) m_actions.size (), "Invalid line of policy file " << path << ": " << line);
+        m_actions.push_back (action);
+      }
+    NS_ABORT_MSG_IF (m_actions.empty (), "Policy file " << path << " has no agents");
+  }
+
+  bool
+  IsLoaded () const
+  {
+    return !m_actions.empty ();
+  }
+
+  uint32_t
+  GetNAgents () const
+  {
+    return m_actions.size ();
+  }
+
+  // Action of agent i, the saved agents are reused cyclically if there are more cheaters
+  const FrozenAction &
+  Get (uint32_t agent) const
+  {
+    return m_actions[agent % m_actions.size ()];
+  }
+
+  // Normalised file contents, part of the result cache key
+  const std::string &
+  GetContents () const
+  {
+    return m_contents;
+  }
+
+private:
+  std::vector<FrozenAction> m_actions;
+  std::string m_contents;
+};
+
+#endif /* FROZEN_POLICY_H */
@@ -0,0 +1,182 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Fixed-memory, log-bucketed histogram of latencies in the spirit of HdrHistogram.
+ *
+ * Values (ns) below 2^SUB_BUCKET_BITS are counted exactly, above that every power
+ * of two is split into 2^(SUB_BUCKET_BITS - 1) linear sub-buckets, which bounds
+ * the relative error of reported percentiles to about 1.6%. Recording a value is
+ * O(1); percentiles are only computed on demand. Reset clears only the range of
+ * buckets touched since the last reset.
+ */
+class LatencyHistogram
+{
+public:
+  static const uint32_t SUB_BUCKET_BITS = 7;
+  static const uint32_t HALF_SUB_BUCKETS = 1 << (SUB_BUCKET_BITS - 1);
+  static const uint32_t MAX_VALUE_BITS = 36; // ~68 s
+  static const uint32_t N_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * HALF_SUB_BUCKETS;
+
+  LatencyHistogram ()
+  {
+    std::memset (m_counts, 0, sizeof (m_counts));
+  }
+
+  void
+  Record (uint64_t valueNs)
+  {
+    valueNs = std::min<uint64_t> (valueNs, (uint64_t (1) << MAX_VALUE_BITS) - 1);
+    uint32_t idx = BucketIndex (valueNs);
+
+    m_counts[idx]++;
+    m_count++;
+    m_sum += valueNs;
+    m_minIdx = std::min (m_minIdx, idx);
+    m_maxIdx = std::max (m_maxIdx, idx);
+  }
+
+  void
+  Merge (const LatencyHistogram &other)
+  {
+    if (other.m_count == 0)
+      {
+        return;
+      }
+
+    for (uint32_t i = other.m_minIdx; i <= other.m_maxIdx; i++)
+      {
+        m_counts[i] += other.m_counts[i];
+      }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_minIdx = std::min (m_minIdx, other.m_minIdx);
+    m_maxIdx = std::max (m_maxIdx, other.m_maxIdx);
+  }
+
+  // Flat state: the bucket counts, the number and the sum of the values. Histograms of other
+  // processes can be summed element-wise (e.g. by an MPI reduction) and merged with AddSerialized.
+  static const uint32_t SERIALIZED_SIZE = N_BUCKETS + 2;
+
+  void
+  Serialize (double *values) const
+  {
+    std::fill (values, values + N_BUCKETS, 0.);
+    for (uint32_t i = m_minIdx; i <= m_maxIdx; i++)
+      {
+        values[i] = m_counts[i];
+      }
+    values[N_BUCKETS] = m_count;
+    values[N_BUCKETS + 1] = m_sum;
+  }
+
+  void
+  AddSerialized (const double *values)
+  {
+    if (values[N_BUCKETS] == 0)
+      {
+        return;
+      }
+
+    for (uint32_t i = 0; i < N_BUCKETS; i++)
+      {
+        if (values[i] > 0)
+          {
+            m_counts[i] += values[i];
+            m_minIdx = std::min (m_minIdx, i);
+            m_maxIdx = std::max (m_maxIdx, i);
+          }
+      }
+    m_count += values[N_BUCKETS];
+    m_sum += values[N_BUCKETS + 1];
+  }
+
+  void
+  Reset ()
+  {
+    if (m_count > 0)
+      {
+        std::memset (m_counts + m_minIdx, 0, (m_maxIdx - m_minIdx + 1) * sizeof (uint32_t));
+      }
+    m_count = 0;
+    m_sum = 0;
+    m_minIdx = N_BUCKETS;
+    m_maxIdx = 0;
+  }
+
+  uint64_t
+  GetCount () const
+  {
+    return m_count;
+  }
+
+  // Mean latency (s)
+  double
+  GetMean () const
+  {
+    return m_count > 0 ? m_sum * 1e-9 / m_count : 0.;
+  }
+
+  // Latency (s) below which a fraction q of the recorded values lie
+  double
+  GetPercentile (double q) const
+  {
+    if (m_count == 0)
+      {
+        return 0.;
+      }
+
+    uint64_t target = std::max<uint64_t> (1, (uint64_t) std::ceil (q * m_count));
+    uint64_t cumulative = 0;
+    for (uint32_t i = m_minIdx; i <= m_maxIdx; i++)
+      {
+        cumulative += m_counts[i];
+        if (cumulative >= target)
+          {
+            return BucketValue (i) * 1e-9;
+          }
+      }
+    return BucketValue (m_maxIdx) * 1e-9;
+  }
+
+private:
+  static uint32_t
+  BucketIndex (uint64_t value)
+  {
+    if (value < 2 * HALF_SUB_BUCKETS)
+      {
+        return value;
+      }
+
+    uint32_t msb = 63 - __builtin_clzll (value);
+    uint32_t shift = msb - (SUB_BUCKET_BITS - 1);
+    return shift * HALF_SUB_BUCKETS + (value >> shift);
+  }
+
+  // Middle of the range of values counted in a bucket
+  static double
+  BucketValue (uint32_t idx)
+  {
+    if (idx < 2 * HALF_SUB_BUCKETS)
+      {
+        return idx;
+      }
+
+    uint32_t shift = idx / HALF_SUB_BUCKETS - 1;
+    uint64_t lower = uint64_t (idx - shift * HALF_SUB_BUCKETS) << shift;
+    return lower + (uint64_t (1) << shift) / 2.;
+  }
+
+  uint32_t m_counts[N_BUCKETS];
+  uint64_t m_count = 0;
+  uint64_t m_sum = 0;
+  uint32_t m_minIdx = N_BUCKETS;
+  uint32_t m_maxIdx = 0;
+};
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -0,0 +1,28 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <fstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Peak resident set size of the process (MB)
+inline double
+GetPeakRss ()
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.; // ru_maxrss is in kB on Linux
+}
+
+// Current resident set size of the process (MB)
+inline double
+GetCurrentRss ()
+{
+  std::ifstream statm ("/proc/self/statm");
+  long size = 0;
+  long resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf (_SC_PAGESIZE) / (1024. * 1024.);
+}
+
+#endif /* MEMORY_USAGE_H */
@@ -0,0 +1,71 @@
+#ifndef NS3_AI_STRUCTURES_H
+#define NS3_AI_STRUCTURES_H
+
+#include "ns3/ns3-ai-module.h"
+
+/*** ns3-ai structures shared by the multi-agent scenarios ***/
+
+// Must match python/envs/ns3_ai_structures.py
+
+#define DEFAULT_MEMBLOCK_KEY 2333
+#define MAX_AGENTS 10
+#define MAX_SCHEDULE 8
+
+struct sEnv
+{
+  double fairness;
+  double latency;
+  double plr;
+  double time;
+  double tx_list[MAX_AGENTS];
+  double lost_list[MAX_AGENTS];
+  double throughput[MAX_AGENTS];
+  double collisions[MAX_AGENTS];
+  double latency_p50[MAX_AGENTS];   // per-packet latency percentiles in the last interaction (s)
+  double latency_p95[MAX_AGENTS];
+  double latency_p99[MAX_AGENTS];
+  double latency_p999[MAX_AGENTS];
+  // Observations of every entry of the last action schedule (schedule_len entries)
+  int schedule_len;
+  double schedule_tx[MAX_SCHEDULE][MAX_AGENTS];
+  double schedule_lost[MAX_SCHEDULE][MAX_AGENTS];
+  double schedule_throughput[MAX_SCHEDULE][MAX_AGENTS];
+  double schedule_collisions[MAX_SCHEDULE][MAX_AGENTS];
+  // Aggregates of the per-step values, exponentially weighted and over the last metricsWindow steps.
+  // The fairness of all stations (fairness above is the one of the last step).
+  double fairness_ewma;
+  double fairness_window;
+  double throughput_ewma[MAX_AGENTS];        // Mb/s
+  double throughput_window[MAX_AGENTS];
+  double collision_ratio_ewma[MAX_AGENTS];   // retried / (retried + received) MPDUs
+  double collision_ratio_window[MAX_AGENTS];
+  double plr_ewma[MAX_AGENTS];
+  double plr_window[MAX_AGENTS];
+  // Queue disc and MAC queue of the station: packets queued now, and the mean sojourn time (s)
+  // and drops of the packets that left the queue in the last interaction. An MPDU leaves the
+  // MAC queue when it is acknowledged, so mac_sojourn includes its retries up to the ack.
+  double qdisc_backlog[MAX_AGENTS];
+  double qdisc_sojourn[MAX_AGENTS];
+  double qdisc_drops[MAX_AGENTS];
+  double mac_backlog[MAX_AGENTS];
+  double mac_sojourn[MAX_AGENTS];
+  double mac_drops[MAX_AGENTS];
+} Packed;
+
+// Negative values leave the corresponding parameter unchanged
+struct sAct
+{
+  bool end_warmup;
+  int cw[MAX_AGENTS];
+  int aifsn[MAX_AGENTS];
+  int txop_limit[MAX_AGENTS];    // us
+  int ampdu_size[MAX_AGENTS];    // B
+  int rts_threshold[MAX_AGENTS]; // B
+  double agent_time;             // time the agents spent computing the action (s)
+  // Optional schedule applied instead of cw - entry e sets schedule_cw[e] for schedule_duration[e] s
+  int schedule_len;
+  double schedule_duration[MAX_SCHEDULE];
+  int schedule_cw[MAX_SCHEDULE][MAX_AGENTS];
+} Packed;
+
+#endif /* NS3_AI_STRUCTURES_H */
@@ -0,0 +1,251 @@
+#ifndef PROFILING_SCHEDULER_H
+#define PROFILING_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/event-impl.h"
+#include "ns3/log.h"
+#include "ns3/object-factory.h"
+#include "ns3/scheduler.h"
+#include "ns3/string.h"
+
+namespace ns3 {
+
+/**
+ * Scheduler that forwards to another scheduler implementation and profiles the events.
+ *
+ * Events are grouped by the dynamic type of their EventImpl. MakeEvent creates one type
+ * per template signature, so rows are labelled with the scheduled callback's type: member
+ * and free functions of the same signature share a row, while every lambda has its own.
+ * The wall time from a RemoveNext call to the next one, or to the IsEmpty check that ends
+ * the run (the execution of the event and the simulator bookkeeping around it), is
+ * attributed to the removed event. The time spent in the inner scheduler itself is
+ * counted separately.
+ */
+class ProfilingScheduler : public Scheduler
+{
+public:
+  static TypeId
+  GetTypeId ()
+  {
+    static TypeId tid = TypeId ("ns3::ProfilingScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<ProfilingScheduler> ()
+      .AddAttribute ("InnerScheduler", "Type of the scheduler the events are forwarded to",
+                     StringValue ("ns3::MapScheduler"),
+                     MakeStringAccessor (&ProfilingScheduler::m_innerType),
+                     MakeStringChecker ());
+    return tid;
+  }
+
+  ProfilingScheduler ()
+  {
+    s_instance = this;
+  }
+
+  ~ProfilingScheduler () override
+  {
+    if (s_instance == this)
+      {
+        s_instance = nullptr;
+      }
+  }
+
+  void
+  Insert (const Event &ev) override
+  {
+    auto start = Clock::now ();
+    GetInner ()->Insert (ev);
+    m_insertTime += Clock::now () - start;
+    m_inserts++;
+  }
+
+  // The simulator checks for events after each one, so the last event of the run is recorded here
+  bool
+  IsEmpty () const override
+  {
+    Checkpoint (Clock::now ());
+    return GetInner ()->IsEmpty ();
+  }
+
+  Event
+  PeekNext () const override
+  {
+    return GetInner ()->PeekNext ();
+  }
+
+  Event
+  RemoveNext () override
+  {
+    auto start = Clock::now ();
+    Checkpoint (start);
+
+    Event ev = GetInner ()->RemoveNext ();
+
+    m_lastRemove = Clock::now ();
+    m_removeTime += m_lastRemove - start;
+    m_removes++;
+    m_lastType = std::type_index (typeid (*ev.impl));
+    m_lastCounted = false;
+    m_running = true;
+    return ev;
+  }
+
+  void
+  Remove (const Event &ev) override
+  {
+    GetInner ()->Remove (ev);
+  }
+
+  // Scheduler of the running simulation, if it is profiled
+  static ProfilingScheduler *
+  Get ()
+  {
+    return s_instance;
+  }
+
+  // Write event counts and wall times sorted by the total time
+  void
+  Report (std::string path) const
+  {
+    // Several EventImpl types can have the same callback type
+    std::unordered_map<std::string, Stats> byLabel;
+    for (auto &entry : m_stats)
+      {
+        Stats &stats = byLabel[CallbackLabel (Demangle (entry.first.name ()))];
+        stats.count += entry.second.count;
+        stats.time += entry.second.time;
+      }
+
+    std::vector<std::pair<std::string, Stats>> rows (byLabel.begin (), byLabel.end ());
+    rows.push_back ({"[scheduler insert]", {m_inserts, m_insertTime}});
+    rows.push_back ({"[scheduler remove]", {m_removes, m_removeTime}});
+
+    std::sort (rows.begin (), rows.end (), [] (auto &a, auto &b) { return a.second.time > b.second.time; });
+
+    std::ofstream file (path);
+    file << "callback,count,totalTime,meanTime" << std::endl;
+    for (auto &row : rows)
+      {
+        double total = std::chrono::duration<double> (row.second.time).count ();
+        file << "\"" << row.first << "\"," << row.second.count << "," << total << ","
+             << (row.second.count > 0 ? total / row.second.count : 0.) << std::endl;
+      }
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats
+  {
+    uint64_t count = 0;
+    Clock::duration time = Clock::duration::zero ();
+  };
+
+  Ptr<Scheduler>
+  GetInner () const
+  {
+    if (!m_inner)
+      {
+        ObjectFactory factory (m_innerType);
+        m_inner = factory.Create<Scheduler> ();
+      }
+    return m_inner;
+  }
+
+  // Attribute the wall time since the last checkpoint to the event removed last
+  void
+  Checkpoint (Clock::time_point now) const
+  {
+    if (!m_running)
+      {
+        return;
+      }
+
+    Stats &stats = m_stats[m_lastType];
+    if (!m_lastCounted)
+      {
+        stats.count++;
+        m_lastCounted = true;
+      }
+    stats.time += now - m_lastRemove;
+    m_lastRemove = now;
+  }
+
+  // First template argument of MakeEvent (the type of the scheduled function or lambda),
+  // or the whole type of other events
+  static std::string
+  CallbackLabel (const std::string &type)
+  {
+    std::string::size_type start = type.find ("MakeEvent<");
+    if (start == std::string::npos)
+      {
+        return type;
+      }
+
+    start += std::string ("MakeEvent<").size ();
+    int depth = 0;
+    for (std::string::size_type i = start; i < type.size (); i++)
+      {
+        char c = type[i];
+        if (c == '<' || c == '(' || c == '[')
+          {
+            depth++;
+          }
+        else if ((c == ',' || c == '>') && depth == 0)
+          {
+            return type.substr (start, i - start);
+          }
+        else if (c == '>' || c == ')' || c == ']')
+          {
+            depth--;
+          }
+      }
+    return type;
+  }
+
+  static std::string
+  Demangle (const char *name)
+  {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle (name, nullptr, nullptr, &status);
+    std::string result = status == 0 ? demangled : name;
+    std::free (demangled);
+
+    // Quotes would break the CSV field
+    std::replace (result.begin (), result.end (), '"', '\'');
+    return result;
+  }
+
+  std::string m_innerType;
+  mutable Ptr<Scheduler> m_inner;
+
+  // Updated from IsEmpty too, which is const in Scheduler
+  mutable std::unordered_map<std::type_index, Stats> m_stats;
+  std::type_index m_lastType = std::type_index (typeid (void));
+  mutable Clock::time_point m_lastRemove;
+  mutable bool m_lastCounted = false;
+  bool m_running = false;
+
+  uint64_t m_inserts = 0;
+  uint64_t m_removes = 0;
+  Clock::duration m_insertTime = Clock::duration::zero ();
+  Clock::duration m_removeTime = Clock::duration::zero ();
+
+  static inline ProfilingScheduler *s_instance = nullptr;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingScheduler);
+
+} // namespace ns3
+
+#endif /* PROFILING_SCHEDULER_H */
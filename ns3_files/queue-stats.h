@@ -0,0 +1,51 @@
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+#include <algorithm>
+#include <cstdint>
+
+// Sojourn time and drops of the packets leaving a queue, updated in O(1) on each dequeue and drop
+struct QueueCounters
+{
+  uint64_t dequeued = 0;
+  uint64_t dropped = 0;
+  double sojournSum = 0.;   // s
+  double sojournMax = 0.;
+
+  void
+  AddSojourn (double sojourn)
+  {
+    dequeued++;
+    sojournSum += sojourn;
+    sojournMax = std::max (sojournMax, sojourn);
+  }
+
+  void
+  AddDrop ()
+  {
+    dropped++;
+  }
+
+  double
+  GetMeanSojourn () const
+  {
+    return dequeued > 0 ? sojournSum / dequeued : 0.;
+  }
+
+  void
+  Reset ()
+  {
+    *this = QueueCounters ();
+  }
+};
+
+// Queue disc and MAC queue of a station, over the current interaction window and since the warmup end
+struct StationQueueStats
+{
+  QueueCounters windowQdisc;
+  QueueCounters windowMac;
+  QueueCounters totalQdisc;
+  QueueCounters totalMac;
+};
+
+#endif /* QUEUE_STATS_H */
@@ -0,0 +1,69 @@
+#ifndef RANDOM_STREAMS_H
+#define RANDOM_STREAMS_H
+
+#include "ns3/abort.h"
+#include "ns3/net-device-container.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/wifi-helper.h"
+
+/*
+ * Fixed random stream layout of the scenarios. Every component gets its own block of
+ * STREAM_BLOCK streams and every station its own streams within it, so that the draws of
+ * a station do not depend on the number of stations, the number of cheaters or the
+ * actions of the agents. CheckStreamLayout guards the blocks against overflow.
+ */
+
+const int64_t STREAM_BLOCK = 1000000;
+const int64_t MOBILITY_STREAM = 0;
+const int64_t CHANNEL_STREAM = 16;
+const int64_t FUZZ_STREAM = 1 * STREAM_BLOCK;        // + station index
+const int64_t POLICY_STREAM = 2 * STREAM_BLOCK;      // behaviour policies of the dataset generation
+const int64_t TRAFFIC_STREAM = 3 * STREAM_BLOCK;     // + 2 * station index
+const int64_t WIFI_STREAM = 4 * STREAM_BLOCK;        // + device index * WIFI_STREAM_BLOCK
+const int64_t WIFI_STREAM_BLOCK = 64;
+const int64_t BSS_STREAM = 100 * STREAM_BLOCK;       // + BSS index * BSS_STREAM_BLOCK (multi-BSS scenario)
+const int64_t BSS_STREAM_BLOCK = 16;
+
+// Abort if the streams of the stations or the devices would run into the next block
+inline void
+CheckStreamLayout (uint64_t nStations, uint64_t nDevices)
+{
+  NS_ABORT_MSG_IF (2 * nStations > STREAM_BLOCK, nStations << " stations overflow the blocks of random streams");
+  NS_ABORT_MSG_IF (nDevices * WIFI_STREAM_BLOCK > BSS_STREAM - WIFI_STREAM,
+                   nDevices << " devices overflow the block of Wi-Fi random streams");
+}
+
+/*
+ * Common random numbers: while an object of this class exists, newly assigned streams
+ * are drawn from the given run instead of RngRun (negative run - no change).
+ */
+class ScopedRngRun
+{
+public:
+  ScopedRngRun (int64_t run)
+    : m_savedRun (ns3::RngSeedManager::GetRun ())
+  {
+    if (run >= 0)
+      {
+        ns3::RngSeedManager::SetRun (run);
+      }
+  }
+
+  ~ScopedRngRun ()
+  {
+    ns3::RngSeedManager::SetRun (m_savedRun);
+  }
+
+private:
+  uint64_t m_savedRun;
+};
+
+// Assign the block of streams of a Wi-Fi device (PHY, MAC and remote station manager)
+inline void
+AssignDeviceStreams (ns3::WifiHelper &wifi, ns3::Ptr<ns3::NetDevice> device, uint32_t deviceIndex)
+{
+  int64_t used = wifi.AssignStreams (ns3::NetDeviceContainer (device), WIFI_STREAM + deviceIndex * WIFI_STREAM_BLOCK);
+  NS_ABORT_MSG_IF (used > WIFI_STREAM_BLOCK, "Wi-Fi device uses " << used << " streams, more than its block");
+}
+
+#endif /* RANDOM_STREAMS_H */
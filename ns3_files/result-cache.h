@@ -0,0 +1,176 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "ns3/rng-seed-manager.h"
+
+/*
+ * Content-addressed cache of the outputs of a scenario. The key hashes the command line
+ * (values of the output path options only count as set or not set), the seed and run of the
+ * RNG, and the build of the binary and of the ns-3 libraries it has loaded.
+ */
+
+// Output files of a run, as (name in the cache entry, output path) pairs
+typedef std::vector<std::pair<std::string, std::string>> CachedFiles;
+
+class Fnv1a
+{
+public:
+  void
+  Add (const char *data, size_t size)
+  {
+    for (size_t i = 0; i < size; i++)
+      {
+        m_hash = (m_hash ^ (uint8_t) data[i]) * 0x100000001b3ULL;
+      }
+  }
+
+  void
+  Add (const std::string &data)
+  {
+    Add (data.data (), data.size ());
+  }
+
+  std::string
+  GetHex () const
+  {
+    std::ostringstream hex;
+    hex << std::hex << std::setw (16) << std::setfill ('0') << m_hash;
+    return hex.str ();
+  }
+
+private:
+  uint64_t m_hash = 0xcbf29ce484222325ULL;
+};
+
+// Contents of the executable and size and modification time of the mapped ns-3 libraries
+inline std::string
+GetBuildId ()
+{
+  Fnv1a hash;
+
+  std::ifstream exe ("/proc/self/exe", std::ios::binary);
+  char buffer[1 << 16];
+  while (exe.read (buffer, sizeof (buffer)) || exe.gcount () > 0)
+    {
+      hash.Add (buffer, exe.gcount ());
+    }
+
+  std::set<std::string> libraries;
+  std::ifstream maps ("/proc/self/maps");
+  for (std::string line; std::getline (maps, line);)
+    {
+      size_t path = line.find ('/');
+      if (path != std::string::npos && line.find ("libns3", path) != std::string::npos)
+        {
+          libraries.insert (line.substr (path));
+        }
+    }
+
+  for (auto &library : libraries)
+    {
+      std::error_code error;
+      auto size = std::filesystem::file_size (library, error);
+      auto time = std::filesystem::last_write_time (library, error).time_since_epoch ().count ();
+      hash.Add (library + ":" + std::to_string (size) + ":" + std::to_string (time) + "\n");
+    }
+
+  return hash.GetHex ();
+}
+
+inline std::string
+GetConfigurationKey (int argc, char *argv[], const std::set<std::string> &outputOptions,
+                     const std::set<std::string> &ignoredOptions)
+{
+  std::vector<std::string> options;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      arg.erase (0, arg.find_first_not_of ('-'));
+
+      size_t separator = arg.find ('=');
+      std::string name = arg.substr (0, separator);
+      std::string value = separator == std::string::npos ? "" : arg.substr (separator + 1);
+
+      if (ignoredOptions.count (name))
+        {
+          continue;
+        }
+      if (outputOptions.count (name))
+        {
+          value = value.empty () ? "" : "set";
+        }
+      options.push_back (name + "=" + value);
+    }
+  std::sort (options.begin (), options.end ());
+
+  Fnv1a hash;
+  for (auto &option : options)
+    {
+      hash.Add (option + "\n");
+    }
+  hash.Add ("RngSeed=" + std::to_string (ns3::RngSeedManager::GetSeed ()) + "\n");
+  hash.Add ("RngRun=" + std::to_string (ns3::RngSeedManager::GetRun ()) + "\n");
+  hash.Add ("build=" + GetBuildId () + "\n");
+  return hash.GetHex ();
+}
+
+// Copy the cached outputs to their paths, returns false if the entry does not exist
+inline bool
+RestoreCachedResults (std::string entryDir, const CachedFiles &files)
+{
+  namespace fs = std::filesystem;
+  if (!fs::exists (fs::path (entryDir) / files.front ().first))
+    {
+      return false;
+    }
+
+  for (auto &file : files)
+    {
+      fs::path cached = fs::path (entryDir) / file.first;
+      if (!file.second.empty () && fs::exists (cached))
+        {
+          fs::copy_file (cached, file.second, fs::copy_options::overwrite_existing);
+        }
+    }
+  return true;
+}
+
+// Store the outputs of a run, the entry appears atomically for the parallel runs
+inline void
+StoreCachedResults (std::string entryDir, const CachedFiles &files)
+{
+  namespace fs = std::filesystem;
+  fs::path tmpDir = entryDir + ".tmp" + std::to_string (getpid ());
+  fs::create_directories (tmpDir);
+
+  for (auto &file : files)
+    {
+      if (!file.second.empty () && fs::exists (file.second))
+        {
+          fs::copy_file (file.second, tmpDir / file.first, fs::copy_options::overwrite_existing);
+        }
+    }
+
+  std::error_code error;
+  fs::rename (tmpDir, entryDir, error);
+  if (error)
+    {
+      fs::remove_all (tmpDir);
+    }
+}
+
+#endif /* RESULT_CACHE_H */
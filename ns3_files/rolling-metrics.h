@@ -0,0 +1,97 @@
+#ifndef ROLLING_METRICS_H
+#define ROLLING_METRICS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Exponentially weighted and sliding-window mean of a per-step value, both updated in O(1)
+class RollingMetric
+{
+public:
+  void
+  Configure (uint32_t window, double alpha)
+  {
+    m_values.assign (std::max (window, 1u), 0.);
+    m_alpha = alpha;
+    m_next = 0;
+    m_count = 0;
+    m_sum = 0.;
+    m_ewma = 0.;
+  }
+
+  void
+  Add (double value)
+  {
+    m_ewma = m_count == 0 ? value : m_alpha * value + (1 - m_alpha) * m_ewma;
+
+    m_sum += value - m_values[m_next];
+    m_values[m_next] = value;
+    m_next = (m_next + 1) % m_values.size ();
+    m_count++;
+
+    // Recompute the sum once per window, so that rounding errors do not accumulate
+    if (m_next == 0)
+      {
+        m_sum = std::accumulate (m_values.begin (), m_values.end (), 0.);
+      }
+  }
+
+  double
+  GetEwma () const
+  {
+    return m_ewma;
+  }
+
+  // Mean of the last K steps (of all steps before K steps are seen)
+  double
+  GetWindowMean () const
+  {
+    uint64_t n = std::min<uint64_t> (m_count, m_values.size ());
+    return n > 0 ? m_sum / n : 0.;
+  }
+
+private:
+  std::vector<double> m_values;
+  double m_alpha = 0.2;
+  uint32_t m_next = 0;
+  uint64_t m_count = 0;
+  double m_sum = 0.;
+  double m_ewma = 0.;
+};
+
+// Jain's fairness index of per-station values, updated in O(1) when the value of a station changes
+class IncrementalJain
+{
+public:
+  void
+  Resize (uint32_t n)
+  {
+    m_values.assign (n, 0.);
+    m_sum = 0.;
+    m_sumSquares = 0.;
+  }
+
+  void
+  Update (uint32_t station, double value)
+  {
+    double old = m_values[station];
+    m_sum += value - old;
+    m_sumSquares += value * value - old * old;
+    m_values[station] = value;
+  }
+
+  double
+  Get () const
+  {
+    return m_sumSquares > 0 ? m_sum * m_sum / (m_values.size () * m_sumSquares) : 1.;
+  }
+
+private:
+  std::vector<double> m_values;
+  double m_sum = 0.;
+  double m_sumSquares = 0.;
+};
+
+#endif /* ROLLING_METRICS_H */
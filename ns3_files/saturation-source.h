@@ -0,0 +1,126 @@
+#ifndef SATURATION_SOURCE_H
+#define SATURATION_SOURCE_H
+
+#include "ns3/application.h"
+#include "ns3/queue-disc.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/traced-callback.h"
+#include "ns3/udp-socket-factory.h"
+
+namespace ns3 {
+
+/**
+ * UDP source that keeps the queues of its station full instead of sending at a fixed rate.
+ *
+ * The source sends until the root queue disc of the station is full (the queue disc passes
+ * packets on to the MAC until the MAC queue stops the device queue) and sends again whenever
+ * the queue disc dequeues a packet. A saturated station transmits the same traffic as with an
+ * OnOffApplication above the channel capacity, without generating the packets dropped at the
+ * full queue disc. Packets carry a SeqTsSizeHeader like the ones of the OnOffApplication,
+ * and every packet sent is reported by the same "Tx" trace.
+ */
+class SaturationSource : public Application
+{
+public:
+  static TypeId
+  GetTypeId ()
+  {
+    static TypeId tid = TypeId ("ns3::SaturationSource")
+      .SetParent<Application> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<SaturationSource> ()
+      .AddTraceSource ("Tx", "A new packet is sent", MakeTraceSourceAccessor (&SaturationSource::m_txTrace),
+                       "ns3::Packet::TracedCallback");
+    return tid;
+  }
+
+  // maxBurst bounds the packets sent at once, in case the device never stops its queue
+  void
+  Setup (Address remote, uint32_t packetSize, uint8_t tos, Ptr<QueueDisc> queueDisc, uint32_t maxBurst)
+  {
+    m_remote = remote;
+    m_packetSize = packetSize;
+    m_tos = tos;
+    m_queueDisc = queueDisc;
+    m_maxBurst = maxBurst;
+  }
+
+private:
+  void
+  StartApplication () override
+  {
+    m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+    m_socket->SetIpTos (m_tos);
+    m_socket->Bind ();
+    m_socket->Connect (m_remote);
+
+    m_queueDisc->TraceConnectWithoutContext ("Dequeue", MakeCallback (&SaturationSource::PacketDequeued, this));
+    m_running = true;
+    Refill ();
+  }
+
+  void
+  StopApplication () override
+  {
+    m_running = false;
+    m_refillEvent.Cancel ();
+    m_queueDisc->TraceDisconnectWithoutContext ("Dequeue", MakeCallback (&SaturationSource::PacketDequeued, this));
+
+    if (m_socket)
+      {
+        m_socket->Close ();
+      }
+  }
+
+  void
+  PacketDequeued (Ptr<const QueueDiscItem> item)
+  {
+    // Refill after the dequeue completes, the queue disc must not be entered from its own trace.
+    // Dequeues of a whole A-MPDU share a single refill.
+    if (m_running && !m_refillEvent.IsPending ())
+      {
+        m_refillEvent = Simulator::ScheduleNow (&SaturationSource::Refill, this);
+      }
+  }
+
+  void
+  Refill ()
+  {
+    for (uint32_t sent = 0; sent < m_maxBurst && m_queueDisc->GetCurrentSize () < m_queueDisc->GetMaxSize (); sent++)
+      {
+        SeqTsSizeHeader header;
+        header.SetSeq (m_seq++);
+        header.SetSize (m_packetSize);
+
+        Ptr<Packet> packet = Create<Packet> (m_packetSize - header.GetSerializedSize ());
+        packet->AddHeader (header);
+        if (m_socket->Send (packet) < 0)
+          {
+            break;
+          }
+        m_txTrace (packet);
+      }
+  }
+
+  Address m_remote;
+  uint32_t m_packetSize = 1500;
+  uint8_t m_tos = 0;
+  Ptr<QueueDisc> m_queueDisc;
+  uint32_t m_maxBurst = 0;
+
+  Ptr<Socket> m_socket;
+  EventId m_refillEvent;
+  bool m_running = false;
+  uint32_t m_seq = 0;
+
+  TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SaturationSource);
+
+} // namespace ns3
+
+#endif /* SATURATION_SOURCE_H */
@@ -16,6 +16,14 @@
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/ns3-ai-module.h"
 #include "ns3/traffic-control-helper.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/qos-txop.h"
+#include "ns3/seq-ts-size-header.h"
+
+#include "app-metrics.h"
+#include "latency-histogram.h"
+#include "profiling-scheduler.h"
+#include "random-streams.h"
 
 using namespace ns3;
 
@@ -32,6 +40,10 @@ struct sEnv
   double plr;
   double throughput;
   double time;
+  double latency_p50;   // per-packet latency percentiles in the last interaction (s)
+  double latency_p95;
+  double latency_p99;
+  double latency_p999;
 } Packed;
 
 struct sAct
@@ -46,7 +58,10 @@ Ns3AIRL<sEnv, sAct> * m_env = new Ns3AIRL<sEnv, sAct> (DEFAULT_MEMBLOCK_KEY);
 
 void ResetMonitor ();
 void InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_t port,
-                              DataRate offeredLoad, uint32_t packetSize);
+                              DataRate offeredLoad, uint32_t packetSize, uint32_t staIndex);
+void SourceTx (uint32_t staIndex, Ptr<const Packet> packet);
+void SinkRxWithSeqTs (uint32_t staIndex, Ptr<const Packet> packet, const Address &from,
+                      const Address &to, const SeqTsSizeHeader &header);
 void PopulateARPcache ();
 void ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t nWifi);
 void SetNetworkConfiguration (int cw_idx);
@@ -54,6 +69,7 @@ void SetNetworkConfiguration (int cw_idx);
 /***** Global variables and constants *****/
 
 double fuzzTime = 5.;
+int64_t crnRun = -1;
 double simulationTime = 5.;
 double interactionTime = 0.5;
 double warmupEndTime = 0.;
@@ -65,11 +81,35 @@ double previousTX = 0;
 double previousLost = 0;
 Time previousDelay = Seconds(0);
 
+// Per-packet latency of each station in the current interaction window and since the warmup end
+std::vector<LatencyHistogram> windowLatency;
+std::vector<LatencyHistogram> runLatency;
+LatencyHistogram networkLatency;
+
+// Traffic of the stations counted by the applications, FlowMonitor is only installed on request
+AppMetrics appMetrics;
+std::vector<FlowCounters> previousStats;
 Ptr<FlowMonitor> monitor;
-std::map<FlowId, FlowMonitor::FlowStats> previousStats;
 
 std::ostringstream csvLogOutput;
 
+// Wi-Fi devices indexed like the NodeList (0 - AP, 1..nWifi - stations)
+std::vector<Ptr<WifiNetDevice>> wifiDevices;
+
+/***** Setup timing *****/
+
+std::chrono::high_resolution_clock::time_point setupStepStart;
+std::vector<std::pair<std::string, double>> setupTimings;
+
+void
+RecordSetupStep (std::string stepName)
+{
+  auto now = std::chrono::high_resolution_clock::now ();
+  std::chrono::duration<double> elapsed = now - setupStepStart;
+  setupTimings.push_back ({stepName, elapsed.count ()});
+  setupStepStart = now;
+}
+
 /***** Main with scenario definition *****/
 
 int
@@ -89,21 +129,28 @@ main (int argc, char *argv[])
   std::string csvPath = "results.csv";
   std::string csvLogPath = "logs.csv";
   std::string flowmonPath = "flowmon.xml";
+  bool flowMonitor = false;
+  std::string setupTimingPath = "";
+  std::string scheduler = "Map";
+  std::string profilePath = "";
 
   int cw_idx = -1;
   bool rts_cts = false;
   bool ampdu = true;
+  bool printPositions = true;
 
   // Parse command line arguments
   CommandLine cmd;
   cmd.AddValue ("agentName", "Name of the agent", agentName);
-  cmd.AddValue ("ampdu", "Enable A-MPDU (only for wifi agent)", ampdu);
+  cmd.AddValue ("ampdu", "Enable A-MPDU", ampdu);
   cmd.AddValue ("channelWidth", "Channel width (MHz)", channelWidth);
+  cmd.AddValue ("crnRun", "Common random numbers: draw positions, traffic and the stations other than the controlled one from this run instead of RngRun (-1 - disabled)", crnRun);
   cmd.AddValue ("csvLogPath", "Path to output CSV log file", csvLogPath);
   cmd.AddValue ("csvPath", "Path to output CSV file", csvPath);
   cmd.AddValue ("cw", "Contention window (const CW = 2 ^ (4 + x) if x >= 0) (only for wifi agent)", cw_idx);
   cmd.AddValue ("dataRate", "Traffic generator data rate (Mb/s)", dataRate);
   cmd.AddValue ("distance", "Max distance between AP and STAs (m)", distance);
+  cmd.AddValue ("flowMonitor", "Install FlowMonitor on all nodes and save its XML to flowmonPath", flowMonitor);
   cmd.AddValue ("flowmonPath", "Path to output flow monitor XML file", flowmonPath);
   cmd.AddValue ("fuzzTime", "Maximum fuzz value (s)", fuzzTime);
   cmd.AddValue ("interactionTime", "Time between agent actions (s)", interactionTime);
@@ -111,10 +158,31 @@ main (int argc, char *argv[])
   cmd.AddValue ("nWifi", "Number of stations", nWifi);
   cmd.AddValue ("packetSize", "Packets size (B)", packetSize);
   cmd.AddValue ("pcapName", "Name of a PCAP file generated from the AP", pcapName);
-  cmd.AddValue ("rtsCts", "Enable RTS/CTS (only for wifi agent)", rts_cts);
+  cmd.AddValue ("printPositions", "Print position of each node", printPositions);
+  cmd.AddValue ("profilePath", "Path to output CSV file with per-callback event counts and wall time (empty - disabled)", profilePath);
+  cmd.AddValue ("rtsCts", "Enable RTS/CTS", rts_cts);
+  cmd.AddValue ("scheduler", "Event scheduler implementation (Map, Heap, List, Calendar, PriorityQueue)", scheduler);
+  cmd.AddValue ("setupTimingPath", "Path to CSV file the per-step setup timing is appended to (empty - disabled)", setupTimingPath);
   cmd.AddValue ("simulationTime", "Duration of simulation (s)", simulationTime);
   cmd.Parse (argc, argv);
 
+  CheckStreamLayout (nWifi, nWifi + 1);
+
+  // Select the event scheduler, optionally wrapped in the profiler
+  ObjectFactory schedulerFactory;
+  if (profilePath.empty ())
+    {
+      schedulerFactory.SetTypeId ("ns3::" + scheduler + "Scheduler");
+    }
+  else
+    {
+      schedulerFactory.SetTypeId ("ns3::ProfilingScheduler");
+      schedulerFactory.Set ("InnerScheduler", StringValue ("ns3::" + scheduler + "Scheduler"));
+    }
+  Simulator::SetScheduler (schedulerFactory);
+
+  setupStepStart = std::chrono::high_resolution_clock::now ();
+
   // Print simulation settings to screen
   std::cout << std::endl
             << "Simulating an IEEE 802.11ax devices with the following settings:" << std::endl
@@ -128,13 +196,15 @@ main (int argc, char *argv[])
             << "- max distance between AP and STAs: " << distance << " m" << std::endl
             << "- simulation time: " << simulationTime << " s" << std::endl
             << "- max fuzz time: " << fuzzTime << " s" << std::endl
-            << "- interaction time: " << interactionTime << " s" << std::endl;
+            << "- interaction time: " << interactionTime << " s" << std::endl
+            << "- common random numbers: " << (crnRun >= 0 ? "run " + std::to_string (crnRun) : "disabled") << std::endl
+            << "- scheduler: " << scheduler << (profilePath.empty () ? "" : " (profiled)") << std::endl
+            << "- RTS/CTS: " << (rts_cts ? "enabled" : "disabled") << std::endl
+            << "- A-MPDU: " << (ampdu ? "enabled" : "disabled") << std::endl;
 
   if (agentName == "wifi")
     {
-      std::cout << "- CW: " << (cw_idx >= 0 ? "2 ^ (4 + " + std::to_string (cw_idx) + ")" : "default" ) << std::endl
-                << "- RTS/CTS: " << (rts_cts ? "enabled" : "disabled") << std::endl
-                << "- A-MPDU: " << (ampdu ? "enabled" : "disabled") << std::endl;
+      std::cout << "- CW: " << (cw_idx >= 0 ? "2 ^ (4 + " + std::to_string (cw_idx) + ")" : "default" ) << std::endl;
     }
 
   useMabAgent = agentName != "wifi";
@@ -145,10 +215,15 @@ main (int argc, char *argv[])
 
   // Configure mobility model
   MobilityHelper mobility;
-  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
-                                 "X", DoubleValue (0.0),
-                                 "Y", DoubleValue (0.0),
-                                 "rho", DoubleValue (distance));
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetX (0.0);
+  positionAllocator->SetY (0.0);
+  positionAllocator->SetRho (distance);
+  {
+    ScopedRngRun environmentRun (crnRun);
+    positionAllocator->AssignStreams (MOBILITY_STREAM);
+  }
+  mobility.SetPositionAllocator (positionAllocator);
 
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
   mobility.Install (wifiApNode);
@@ -159,37 +234,60 @@ main (int argc, char *argv[])
   apMobility->SetPosition (Vector (0.0, 0.0, 0.0));
 
   // Print position of each node
-  std::cout << std::endl << "Node positions:" << std::endl;
+  if (printPositions)
+    {
+      std::cout << std::endl << "Node positions:" << std::endl;
 
-  // AP position
-  Ptr<MobilityModel> position = wifiApNode.Get (0)->GetObject<MobilityModel> ();
-  Vector pos = position->GetPosition ();
-  std::cout << "AP:\tx=" << pos.x << ", y=" << pos.y << std::endl;
+      // AP position
+      Vector pos = apMobility->GetPosition ();
+      std::cout << "AP:\tx=" << pos.x << ", y=" << pos.y << std::endl;
 
-  // Stations positions
-  for (auto node = wifiStaNodes.Begin (); node != wifiStaNodes.End (); ++node)
-    {
-      position = (*node)->GetObject<MobilityModel> ();
-      pos = position->GetPosition ();
-      std::cout << "Sta " << (*node)->GetId () << ":\tx=" << pos.x << ", y=" << pos.y << std::endl;
+      // Stations positions
+      for (auto node = wifiStaNodes.Begin (); node != wifiStaNodes.End (); ++node)
+        {
+          pos = (*node)->GetObject<MobilityModel> ()->GetPosition ();
+          std::cout << "Sta " << (*node)->GetId () << ":\tx=" << pos.x << ", y=" << pos.y << std::endl;
+        }
+
+      std::cout << std::endl;
     }
 
-  std::cout << std::endl;
+  RecordSetupStep ("nodes and mobility");
 
   // Configure wireless channel
   YansWifiPhyHelper phy;
   YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
-  phy.SetChannel (channelHelper.Create ());
+  Ptr<YansWifiChannel> channel = channelHelper.Create ();
+  {
+    ScopedRngRun environmentRun (crnRun);
+    channelHelper.AssignStreams (channel, CHANNEL_STREAM);
+  }
+  phy.SetChannel (channel);
+
+  // Set channel width on the helper, so that every PHY is created with it
+  phy.Set ("ChannelSettings", StringValue ("{0, " + std::to_string (channelWidth) + ", BAND_5GHZ, 0}"));
 
   // Configure MAC layer
   
   WifiHelper wifi;
   WifiMacHelper mac;
   wifi.SetStandard (WIFI_STANDARD_80211ax);
-  wifi.SetRemoteStationManager ("ns3::IdealWifiManager");
+  if (rts_cts)
+    {
+      wifi.SetRemoteStationManager ("ns3::IdealWifiManager", "RtsCtsThreshold", UintegerValue (0));
+    }
+  else
+    {
+      wifi.SetRemoteStationManager ("ns3::IdealWifiManager");
+    }
 
   mac.SetType("ns3::AdhocWifiMac");
 
+  if (!ampdu)
+    {
+      mac.SetType ("ns3::AdhocWifiMac", "BE_MaxAmpduSize", UintegerValue (0));
+    }
+
   // Set SSID
   Ssid ssid = Ssid ("ns3-80211ax");
   // mac.SetType ("ns3::StaWifiMac",
@@ -202,43 +300,77 @@ main (int argc, char *argv[])
 
   NetDeviceContainer apDevice;
   apDevice = wifi.Install (phy, mac, wifiApNode);
-  
-  // Set channel width
-  Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/ChannelSettings",
-               StringValue ("{0, " + std::to_string (channelWidth) + ", BAND_5GHZ, 0}"));
+
+  // Keep direct handles to the devices, so that nothing below has to resolve Config paths
+  wifiDevices.reserve (nWifi + 1);
+  wifiDevices.push_back (DynamicCast<WifiNetDevice> (apDevice.Get (0)));
+  for (uint32_t j = 0; j < staDevice.GetN (); ++j)
+    {
+      wifiDevices.push_back (DynamicCast<WifiNetDevice> (staDevice.Get (j)));
+    }
+
+  // Give every device its own block of streams. The controlled station always draws from RngRun,
+  // whichever agent (or the wifi baseline) runs it, so the baseline and the agents share the environment.
+  for (uint32_t j = 0; j < wifiDevices.size (); ++j)
+    {
+      ScopedRngRun environmentRun (j == 1 ? -1 : crnRun);
+      AssignDeviceStreams (wifi, wifiDevices[j], j);
+    }
+
+  RecordSetupStep ("wifi devices");
 
   // Install an Internet stack
   InternetStackHelper stack;
   stack.Install (wifiApNode);
   stack.Install (wifiStaNodes);
 
+  RecordSetupStep ("internet stack");
+
   TrafficControlHelper tch;
   tch.SetRootQueueDisc("ns3::FifoQueueDisc", "MaxSize",  StringValue(std::to_string(maxQueueSize)+"p"));
   tch.Install(staDevice);
   tch.Install(apDevice);
 
+  RecordSetupStep ("traffic control");
+
   // Configure IP addressing
   Ipv4AddressHelper address ("192.168.1.0", "255.255.255.0");
   Ipv4InterfaceContainer staNodeInterface = address.Assign (staDevice);
   Ipv4InterfaceContainer apNodeInterface = address.Assign (apDevice);
 
+  RecordSetupStep ("ip addressing");
+
   // PopulateArpCache
   PopulateARPcache ();
 
+  RecordSetupStep ("arp cache");
+
   // Configure applications
+  appMetrics.Resize (nWifi);
+  previousStats = appMetrics.GetAll ();
+  windowLatency.resize (nWifi);
+  runLatency.resize (nWifi);
+
   DataRate applicationDataRate = DataRate (dataRate * 1e6);
   uint32_t portNumber = 9;
 
   for (uint32_t j = 0; j < wifiStaNodes.GetN (); ++j)
     {
       InstallTrafficGenerator (wifiStaNodes.Get (j), wifiApNode.Get (0), portNumber++,
-                               applicationDataRate, packetSize);
+                               applicationDataRate, packetSize, j);
     }
 
-  // Install FlowMonitor
+  RecordSetupStep ("applications");
+
+  // Install FlowMonitor (the metrics come from the applications, it only adds the XML output)
   FlowMonitorHelper flowmon;
-  monitor = flowmon.InstallAll ();
-  csvLogOutput << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,time" << std::endl;
+  if (flowMonitor)
+    {
+      monitor = flowmon.InstallAll ();
+    }
+  csvLogOutput << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,time,latencyP50,latencyP95,latencyP99,latencyP999" << std::endl;
+
+  RecordSetupStep ("flow monitor");
 
   // Generate PCAP at AP
   if (!pcapName.empty ())
@@ -253,6 +385,33 @@ main (int argc, char *argv[])
       SetNetworkConfiguration (cw_idx);
     }
 
+  RecordSetupStep ("pcap and agent configuration");
+
+  // Print setup timing
+  double setupTime = 0.;
+  std::cout << "Setup timing:" << std::endl;
+  for (auto &step : setupTimings)
+    {
+      std::cout << "- " << step.first << ": " << step.second << " s" << std::endl;
+      setupTime += step.second;
+    }
+  std::cout << "- total: " << setupTime << " s" << std::endl << std::endl;
+
+  if (!setupTimingPath.empty ())
+    {
+      bool writeHeader = !std::filesystem::exists (setupTimingPath);
+      std::ofstream setupTimingFile (setupTimingPath, std::ios::app);
+      if (writeHeader)
+        {
+          setupTimingFile << "nWifi,step,time" << std::endl;
+        }
+      for (auto &step : setupTimings)
+        {
+          setupTimingFile << nWifi << "," << step.first << "," << step.second << std::endl;
+        }
+      setupTimingFile << nWifi << ",total," << setupTime << std::endl;
+    }
+
   m_env->SetCond (2, 0);
   Simulator::Schedule (Seconds (fuzzTime), &ResetMonitor);
   Simulator::Schedule (Seconds (fuzzTime), &ExecuteAction, agentName, dataRate, distance, nWifi);
@@ -269,26 +428,35 @@ main (int argc, char *argv[])
   std::chrono::duration<double> elapsed = finish - start;
   
 
+  double wallTime = elapsed.count ();
+  uint64_t events = Simulator::GetEventCount ();
+
   std::cout << "Done!" << std::endl
-            << "Elapsed time: " << elapsed.count () << " s" << std::endl
+            << "Elapsed time: " << wallTime << " s" << std::endl
+            << "Events: " << events << " (" << events / wallTime << " events/s)" << std::endl
             << std::endl;
 
+  if (!profilePath.empty ())
+    {
+      ProfilingScheduler::Get ()->Report (profilePath);
+      std::cout << "Event profile saved to: " << profilePath << std::endl << std::endl;
+    }
+
   // Calculate per-flow throughput and Jain's fairness index
   double nWifiReal = 0;
   double jainsIndexN = 0.;
   double jainsIndexD = 0.;
 
-  Time latencySum = Seconds(0);
+  double latencySum = 0.;
   double lostSum = 0.;
   double txSum = 0.;
 
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  const std::vector<FlowCounters> &stats = appMetrics.GetAll ();
   std::cout << "Results: " << std::endl;
 
-  for (auto &stat : stats)
+  for (uint32_t i = 0; i < nWifi; i++)
   {
-    double flow = 8 * stat.second.rxBytes / (1e6 * simulationTime);
+    double flow = 8 * stats[i].rxBytes / (1e6 * simulationTime);
 
     if (flow > 0)
       {
@@ -298,19 +466,17 @@ main (int argc, char *argv[])
     jainsIndexN += flow;
     jainsIndexD += flow * flow;
 
-    latencySum += stat.second.delaySum;
-    lostSum += stat.second.lostPackets;
-    txSum += stat.second.txPackets;
+    latencySum += stats[i].delaySum;
+    lostSum += stats[i].lostPackets;
+    txSum += stats[i].txPackets;
 
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (stat.first);
-    std::cout << "Flow " << stat.first << " (" << t.sourceAddress << " -> "
-              << t.destinationAddress << ")\tThroughput: " << flow << " Mb/s" << std::endl;
+    std::cout << "Station " << i << "\tThroughput: " << flow << " Mb/s" << std::endl;
   }
 
   double totalThr = jainsIndexN;
   double fairnessIndex = jainsIndexN * jainsIndexN / (nWifiReal * jainsIndexD);
   double totalPLR = lostSum / txSum;
-  double totalLatency = latencySum.GetSeconds();
+  double totalLatency = latencySum;
   double latencyPerPacketTotal = totalLatency / txSum;
   double avgTHR = 0;
   double cheaterTHR = 0;
@@ -318,9 +484,9 @@ main (int argc, char *argv[])
   if (agentName != "wifi") {
     for (uint32_t i=1; i <= nWifi; i++) {
       if (i == 1) {
-        cheaterTHR = 8 * ( stats[i].rxBytes) / (1e6 * simulationTime);
+        cheaterTHR = 8 * ( stats[i-1].rxBytes) / (1e6 * simulationTime);
       } else {
-        double flow = 8 * ( stats[i].rxBytes) / (1e6 * simulationTime);
+        double flow = 8 * ( stats[i-1].rxBytes) / (1e6 * simulationTime);
         avgTHR += flow;
       }
     }
@@ -341,6 +507,9 @@ main (int argc, char *argv[])
             << "PLR: " << totalPLR << std::endl
             << "Total Latency: " << totalLatency << std::endl
             << "Latency per packet: " << latencyPerPacketTotal << std::endl
+            << "Latency p50/p95/p99/p99.9: " << networkLatency.GetPercentile (0.5) << " / "
+            << networkLatency.GetPercentile (0.95) << " / " << networkLatency.GetPercentile (0.99) << " / "
+            << networkLatency.GetPercentile (0.999) << " s" << std::endl
             << std::endl;
 
   // Gather results in CSV format
@@ -348,10 +517,13 @@ main (int argc, char *argv[])
   csvOutput << agentName << "," << dataRate << "," << distance << "," << nWifi << "," << nWifiReal << ","
             << RngSeedManager::GetRun () << "," << warmupEndTime << "," << fairnessIndex << ","
             << latencyPerPacketTotal << "," << totalPLR << "," << totalThr << "," 
-            << cheaterTHR << "," << avgTHR << std::endl;
+            << cheaterTHR << "," << avgTHR << "," << setupTime << ","
+            << networkLatency.GetPercentile (0.5) << "," << networkLatency.GetPercentile (0.95) << ","
+            << networkLatency.GetPercentile (0.99) << "," << networkLatency.GetPercentile (0.999) << ","
+            << scheduler << "," << wallTime << "," << events << std::endl;
 
   // Print results to std output
-  std::cout << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,cheaterTHR,avgTHR"
+  std::cout << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,cheaterTHR,avgTHR,setupTime,latencyP50,latencyP95,latencyP99,latencyP999,scheduler,wallTime,events"
             << std::endl
             << csvOutput.str ();
 
@@ -364,8 +536,11 @@ main (int argc, char *argv[])
   outputLogFile << csvLogOutput.str ();
   std::cout << std::endl << "Simulation log saved to: " << csvLogPath << std::endl << std::endl;
 
-  monitor->SerializeToXmlFile (flowmonPath, true, true);
-  std::cout << "Flow monitor data saved to: " << flowmonPath << std::endl;
+  if (monitor)
+    {
+      monitor->SerializeToXmlFile (flowmonPath, true, true);
+      std::cout << "Flow monitor data saved to: " << flowmonPath << std::endl;
+    }
 
   // Cleanup
   Simulator::Destroy ();
@@ -379,18 +554,46 @@ main (int argc, char *argv[])
 void
 ResetMonitor ()
 {
-  monitor->CheckForLostPackets ();
-  monitor->ResetAllStats ();
-  previousStats = monitor->GetFlowStats ();
+  if (monitor)
+    {
+      monitor->CheckForLostPackets ();
+      monitor->ResetAllStats ();
+    }
+  appMetrics.Reset ();
+  previousStats = appMetrics.GetAll ();
   previousRX = 0;
   previousTX = 0;
   previousLost = 0;
   previousDelay = Seconds(0);
+
+  for (uint32_t i = 0; i < runLatency.size (); i++)
+    {
+      windowLatency[i].Reset ();
+      runLatency[i].Reset ();
+    }
+  networkLatency.Reset ();
+}
+
+void
+SinkRxWithSeqTs (uint32_t staIndex, Ptr<const Packet> packet, const Address &from,
+                 const Address &to, const SeqTsSizeHeader &header)
+{
+  Time delay = Simulator::Now () - header.GetTs ();
+  appMetrics.RecordRx (staIndex, header.GetSize (), header.GetSeq (), delay.GetSeconds ());
+  windowLatency[staIndex].Record (delay.GetNanoSeconds ());
+  runLatency[staIndex].Record (delay.GetNanoSeconds ());
+  networkLatency.Record (delay.GetNanoSeconds ());
+}
+
+void
+SourceTx (uint32_t staIndex, Ptr<const Packet> packet)
+{
+  appMetrics.RecordTx (staIndex, packet->GetSize ());
 }
 
 void
 InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_t port,
-                         DataRate offeredLoad, uint32_t packetSize)
+                         DataRate offeredLoad, uint32_t packetSize, uint32_t staIndex)
 {
   // Get sink address
   Ptr<Ipv4> ipv4 = toNode->GetObject<Ipv4> ();
@@ -399,24 +602,31 @@ InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_
   // Define type of service
   uint8_t tosValue = 0x70; //AC_BE
 
-  // Add random fuzz to app start time
+  // Add random fuzz to app start time, from a stream of the station
+  ScopedRngRun environmentRun (crnRun);
   Ptr<UniformRandomVariable> fuzz = CreateObject<UniformRandomVariable> ();
   fuzz->SetAttribute ("Min", DoubleValue (0.));
   fuzz->SetAttribute ("Max", DoubleValue (fuzzTime));
-  fuzz->SetStream (0);
+  fuzz->SetStream (FUZZ_STREAM + staIndex);
   double applicationsStart = fuzz->GetValue ();
 
   // Configure source and sink
   InetSocketAddress sinkSocket (addr, port);
   PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket);
+  packetSinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
 
   OnOffHelper onOffHelper ("ns3::UdpSocketFactory", sinkSocket);
   onOffHelper.SetConstantRate (offeredLoad, packetSize);
   onOffHelper.SetAttribute("Tos", UintegerValue(tosValue));
+  onOffHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
 
   // Configure applications
   ApplicationContainer sinkApplications (packetSinkHelper.Install (toNode));
   ApplicationContainer sourceApplications (onOffHelper.Install (fromNode));
+  onOffHelper.AssignStreams (NodeContainer (fromNode), TRAFFIC_STREAM + 2 * staIndex);
+
+  sinkApplications.Get (0)->TraceConnectWithoutContext ("RxWithSeqTsSize", MakeBoundCallback (&SinkRxWithSeqTs, staIndex));
+  sourceApplications.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&SourceTx, staIndex));
 
   sinkApplications.Start (Seconds (applicationsStart));
   sourceApplications.Start (Seconds (applicationsStart));
@@ -428,17 +638,23 @@ PopulateARPcache ()
   Ptr<ArpCache> arp = CreateObject<ArpCache> ();
   arp->SetAliveTimeout (Seconds (3600 * 24 * 365));
 
+  // Single pass: the cache is shared, so it can be attached to an interface
+  // before the remaining entries are added
   for (auto i = NodeList::Begin (); i != NodeList::End (); ++i)
     {
       Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
-      ObjectVectorValue interfaces;
-      ip->GetAttribute ("InterfaceList", interfaces);
 
-      for (auto j = interfaces.Begin (); j != interfaces.End (); j++)
+      for (uint32_t j = 0; j < ip->GetNInterfaces (); j++)
         {
-          Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
+          Ptr<Ipv4Interface> ipIface = ip->GetInterface (j);
           Ptr<NetDevice> device = ipIface->GetDevice ();
+          if (!Mac48Address::IsMatchingType (device->GetAddress ()))
+            {
+              continue;
+            }
+
           Mac48Address addr = Mac48Address::ConvertFrom (device->GetAddress ());
+          ipIface->SetArpCache (arp);
 
           for (uint32_t k = 0; k < ipIface->GetNAddresses (); k++)
             {
@@ -449,28 +665,11 @@ PopulateARPcache ()
                 }
 
               ArpCache::Entry *entry = arp->Add (ipAddr);
-              Ipv4Header ipv4Hdr;
-              ipv4Hdr.SetDestination (ipAddr);
-
-              Ptr<Packet> p = Create<Packet> (100);
-              entry->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (p, ipv4Hdr));
-              entry->MarkAlive (addr);
+              entry->SetMacAddress (addr);
+              entry->MarkPermanent ();
             }
         }
     }
-
-  for (auto i = NodeList::Begin (); i != NodeList::End (); ++i)
-    {
-      Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
-      ObjectVectorValue interfaces;
-      ip->GetAttribute ("InterfaceList", interfaces);
-
-      for (auto j = interfaces.Begin (); j != interfaces.End (); j++)
-        {
-          Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
-          ipIface->SetAttribute ("ArpCache", PointerValue (arp));
-        }
-    }
 }
 
 void
@@ -485,14 +684,13 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
   double currentLost = 0;
   Time currentDelay = Seconds (0);
 
-  monitor->CheckForLostPackets ();
-  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  const std::vector<FlowCounters> &stats = appMetrics.GetAll ();
 
-  double flow = 8 * ( stats[1].rxBytes - previousStats[1].rxBytes) / (1e6 * interactionTime);
-  currentLost += stats[1].lostPackets;
-  currentRX += stats[1].rxPackets;
-  currentTX += stats[1].txPackets;
-  currentDelay += stats[1].delaySum;
+  double flow = 8 * ((double) stats[0].rxBytes - previousStats[0].rxBytes) / (1e6 * interactionTime);
+  currentLost += stats[0].lostPackets;
+  currentRX += stats[0].rxPackets;
+  currentTX += stats[0].txPackets;
+  currentDelay += Seconds (stats[0].delaySum);
   if (flow > 0)
     {
       nWifiReal += 1;
@@ -527,6 +725,10 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
       env->plr = PLR;
       env->throughput = throughput;
       env->time = Simulator::Now ().GetSeconds () - fuzzTime;
+      env->latency_p50 = windowLatency[0].GetPercentile (0.5);
+      env->latency_p95 = windowLatency[0].GetPercentile (0.95);
+      env->latency_p99 = windowLatency[0].GetPercentile (0.99);
+      env->latency_p999 = windowLatency[0].GetPercentile (0.999);
       m_env->SetCompleted ();
 
       auto act = m_env->ActionGetterCond ();
@@ -552,7 +754,14 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
     }
 
   csvLogOutput << agentName << "," << dataRate << "," << distance << "," << nWifi << "," << nWifiReal << "," << RngSeedManager::GetRun () << "," << end_warmup << ","
-  << fairnessIndex << "," << latencyPerPacket << "," << PLR << "," << throughput << "," << Simulator::Now().GetSeconds() - fuzzTime << std::endl;
+  << fairnessIndex << "," << latencyPerPacket << "," << PLR << "," << throughput << "," << Simulator::Now().GetSeconds() - fuzzTime << ","
+  << windowLatency[0].GetPercentile (0.5) << "," << windowLatency[0].GetPercentile (0.95) << ","
+  << windowLatency[0].GetPercentile (0.99) << "," << windowLatency[0].GetPercentile (0.999) << std::endl;
+
+  for (auto &histogram : windowLatency)
+    {
+      histogram.Reset ();
+    }
 
   Simulator::Schedule (Seconds(interactionTime), &ExecuteAction, agentName, dataRate, distance, nWifi);
 }
@@ -563,8 +772,8 @@ SetNetworkConfiguration (int cw_idx)
   if (cw_idx >= 0)
     {
       // Set CW
-      AttributeContainerValue<UintegerValue> cwValue { std::vector {UintegerValue (pow (2, cw_idx))} };
-      Config::Set ("/NodeList/1/DeviceList/*/$ns3::WifiNetDevice/Mac/BE_Txop/MinCws", cwValue);
-      Config::Set ("/NodeList/1/DeviceList/*/$ns3::WifiNetDevice/Mac/BE_Txop/MaxCws", cwValue);
+      Ptr<QosTxop> txop = wifiDevices[1]->GetMac ()->GetQosTxop (AC_BE);
+      txop->SetMinCw (pow (2, cw_idx));
+      txop->SetMaxCw (pow (2, cw_idx));
     }
 }
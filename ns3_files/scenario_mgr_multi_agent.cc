@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <string>
 #include <iostream>
@@ -18,37 +20,40 @@
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/ns3-ai-module.h"
 #include "ns3/traffic-control-helper.h"
+#include "ns3/traffic-control-layer.h"
 #include "ns3/wifi-mpdu.h"
 #include "ns3/wifi-mac.h"
-
+#include "ns3/qos-txop.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/ampdu-subframe-header.h"
+#include "ns3/wifi-mac-queue.h"
+#include "ns3/wifi-psdu.h"
+
+#include <unordered_map>
+
+
+#include "latency-histogram.h"
+#include "memory-usage.h"
+#include "app-metrics.h"
+#include "event-ring.h"
+#include "frozen-policy.h"
+#include "ns3-ai-structures.h"
+#include "profiling-scheduler.h"
+#include "queue-stats.h"
+#include "random-streams.h"
+#include "result-cache.h"
+#include "rolling-metrics.h"
+#include "saturation-source.h"
+#include "telemetry-server.h"
+#include "transition-dataset.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("scenario");
 
-/*** ns3-ai structures definitions ***/
-
-#define DEFAULT_MEMBLOCK_KEY 2333
-
-struct sEnv
-{
-  double fairness;
-  double latency;
-  double plr;
-  double time;
-  double tx_list[10];
-  double lost_list[10];
-  double throughput[10];
-  double collisions[10];
-} Packed;
-
-struct sAct
-{
-  bool end_warmup;
-  int cw[10];
-} Packed;
-
-Ns3AIRL<sEnv, sAct> * m_env = new Ns3AIRL<sEnv, sAct> (DEFAULT_MEMBLOCK_KEY);
+// Created in main, the dataset generation runs without the agents' process
+Ns3AIRL<sEnv, sAct> * m_env = nullptr;
 
 /***** Functions declarations *****/
 void splitString(std::string& input, char delimiter,
@@ -62,15 +67,53 @@ void splitString(std::string& input, char delimiter,
 }
 
 double global_collinsions_ap = 0;
-double global_drop_list[10];
-double previous_global_drop_list[10];
+std::vector<double> global_drop_list;
+std::vector<double> previous_global_drop_list;
 void ResetMonitor ();
 void InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_t port,
-                              DataRate offeredLoad, uint32_t packetSize);
+                              DataRate offeredLoad, uint32_t packetSize, uint32_t staIndex);
+void InstallTrafficSource (Ptr<ns3::Node> fromNode, InetSocketAddress sinkSocket, DataRate offeredLoad,
+                           uint32_t packetSize, uint32_t staIndex, double start);
+void StationAssociated (uint32_t staIndex, Mac48Address bssid);
+void StationBeacon (uint32_t staIndex, Time arrival);
+void ApplyEdcaOverride (uint32_t staIndex);
+void CheckAssociation ();
+void SourceTx (uint32_t staIndex, Ptr<const Packet> packet);
+void SinkRxWithSeqTs (uint32_t staIndex, Ptr<const Packet> packet, const Address &from,
+                      const Address &to, const SeqTsSizeHeader &header);
 void PopulateARPcache ();
 void ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t nWifi, int cheaterNumber);
 void SetNetworkConfiguration (int cw_idx);
 void SetNetworkConfigurationCheater (int cw_idx, int cheaterNum);
+void SetEdcaConfigurationCheater (int aifsn, int txopLimit, int ampduSize, int rtsThreshold, int cheaterNum);
+void ParseActionDims (std::string actionDims);
+void DetectorPhyState (Time start, Time duration, WifiPhyState state);
+void DetectorSnifferRx (Ptr<const Packet> packet, uint16_t channelFreqMhz, WifiTxVector txVector,
+                        MpduInfo aMpdu, SignalNoiseDbm signalNoise, uint16_t staId);
+void MarkMisbehaviour (uint32_t staIndex, bool misbehaving);
+void MonitorMemory (std::string csvLogPath);
+void RecordInteraction (std::chrono::high_resolution_clock::time_point timestamps[5], double agentTime);
+void StartScheduleEntry (int entry, int cheaterNumber);
+void CollectScheduleEntry (int entry, int cheaterNumber);
+void NextScheduleEntry (int entry, int cheaterNumber);
+void BoundMemoryUse (std::string csvLogPath);
+void PublishTelemetry (uint32_t nWifi);
+void CollisionTxBegin (uint32_t deviceIndex, Ptr<const Packet> packet, double txPowerW);
+void CollisionTxEnd (uint32_t deviceIndex, Ptr<const Packet> packet);
+void CollisionRxDrop (Ptr<const Packet> packet, WifiPhyRxfailureReason reason);
+void CollisionRxError (Ptr<const Packet> packet, double snr);
+void AttributeCollision (Ptr<const Packet> packet);
+void FlushCollisionWindow ();
+void QdiscSojourn (uint32_t staIndex, Time sojourn);
+void QdiscDrop (uint32_t staIndex, Ptr<const QueueDiscItem> item);
+void MacQueueDequeue (uint32_t staIndex, Time maxDelay, Ptr<const WifiMpdu> mpdu);
+void MacQueueDrop (uint32_t staIndex, Ptr<const WifiMpdu> mpdu);
+void EventTxBegin (uint32_t deviceIndex, WifiConstPsduMap psduMap, WifiTxVector txVector, double txPowerW);
+void EventAcked (uint32_t deviceIndex, Ptr<const WifiMpdu> mpdu);
+void EventDropped (uint32_t deviceIndex, WifiMacDropReason reason, Ptr<const WifiMpdu> mpdu);
+void ApplyFrozenPolicy (int cheaterNumber);
+void ApplyBehaviourPolicy (int cheaterNumber, double *throughput_list, double *tx_list,
+                           double *lost_list, double *collisions_list);
 void TxDrop (std::string context,uint8_t reason, Ptr< const WifiMpdu > mpdu, const WifiTxVector &txVector)
 { 
   char delimiter = '/';
@@ -93,21 +136,16 @@ void TxDropMac (std::string context, const Ptr< const Packet > packet)
   std::cout << "Droped phy packet " << std::endl;
 }
 
-void MonitorRetransmissions(std::string context, Ptr<const Packet> packet) {
+void MonitorRetransmissions(uint32_t nodeIndex, Ptr<const Packet> packet) {
     WifiMacHeader header;
-    std::string arrayOfSubStr[100];
-    char delimiter = '/';
-    int index = 0;
-    
+
     if (packet->PeekHeader(header)) { // Wyodrębnienie nagłówka WifiMacHeader
       int IsRetry = header.IsRetry();
         if (IsRetry == 1) {
-            splitString(context, delimiter, arrayOfSubStr, index);
-            int collisionIndex = stoi(arrayOfSubStr[2]);
-            if (collisionIndex == 0){
+            if (nodeIndex == 0){
               global_collinsions_ap++;
             } else {
-              global_drop_list[collisionIndex-1]++;
+              global_drop_list[nodeIndex-1]++;
             }
         }
     }
@@ -136,11 +174,22 @@ void IpCheck(std::string context, Ptr<const Packet> packet) {
 /***** Global variables and constants *****/
 
 double fuzzTime = 5.;
+int64_t crnRun = -1;
 double simulationTime = 5.;
 double interactionTime = 0.5;
+double currentInteractionTime = 0.5;   // length of the running period between two exchanges
 double warmupEndTime = 0.;
 bool simulationPhase = false;
 bool useMabAgent = false;
+bool infraMode = false;
+std::string trafficMode = "onoff";
+
+// Action dimensions the agents are allowed to control (see --actionDims)
+bool actionCw = true;
+bool actionAifsn = false;
+bool actionTxop = false;
+bool actionAmpdu = false;
+bool actionRts = false;
 
 
 
@@ -149,11 +198,234 @@ double previousTX = 0;
 double previousLost = 0;
 Time previousDelay = Seconds(0);
 
+// Per-packet latency of each station in the current interaction window and since the warmup end
+std::vector<LatencyHistogram> windowLatency;
+std::vector<LatencyHistogram> runLatency;
+LatencyHistogram networkLatency;
+
+// Traffic of the stations counted by the applications, FlowMonitor is only installed on request
+AppMetrics appMetrics;
+std::vector<FlowCounters> previousStats;
 Ptr<FlowMonitor> monitor;
-std::map<FlowId, FlowMonitor::FlowStats> previousStats;
 
 std::ostringstream csvLogOutput;
 
+// Wi-Fi devices indexed like the NodeList (0 - AP, 1..nWifi - stations)
+std::vector<Ptr<WifiNetDevice>> wifiDevices;
+QueueDiscContainer queueDiscs;
+
+/***** Agent interaction timing *****/
+
+// Wall time of the phases of every interaction with the agents: building the observation,
+// publishing it, waiting for the action, and applying it. The agent reports its own
+// computation time, the rest of the wait is the shared-memory hand-off.
+LatencyHistogram buildTime;
+LatencyHistogram publishTime;
+LatencyHistogram waitTime;
+LatencyHistogram agentTime;
+LatencyHistogram applyTime;
+LatencyHistogram handshakeTime;
+uint64_t interactionStep = 0;
+
+// Per-step trace of the phases (empty path - disabled)
+std::ofstream interactionTraceFile;
+
+/***** Infrastructure mode *****/
+
+// EDCA parameters the agents set on a station, indexed like wifiDevices (negative - not set).
+// The AP advertises its own parameters in every beacon and the stations adopt them, so in the
+// infrastructure mode the overrides are applied again after a (re)association and after the
+// beacons of the overridden stations, only when the advertised set replaced them.
+struct EdcaOverride
+{
+  int cwMin = -1;
+  int aifsn = -1;
+  int txopLimit = -1;  // us
+};
+std::vector<EdcaOverride> edcaOverrides;
+
+// Traffic sources waiting for the association of their station
+std::vector<std::function<void ()>> pendingSources;
+std::vector<bool> stationAssociated;
+uint32_t associatedStations = 0;
+double associationTime = -1.;
+
+/***** Action schedules *****/
+
+// Schedule received with the last action: entry e sets scheduleCw[e] for scheduleDuration[e] s.
+// The entries run back to back without an exchange with the agents, their observations are
+// returned together at the next exchange.
+int scheduleLen = 0;
+double scheduleDuration[MAX_SCHEDULE];
+int scheduleCw[MAX_SCHEDULE][MAX_AGENTS];
+
+int scheduleEntry = 0;
+int scheduleObserved = 0;
+EventId scheduleEvent;
+std::vector<FlowCounters> scheduleStats;
+std::vector<double> scheduleDrops;
+
+double scheduleTx[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleLost[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleThroughput[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleCollisions[MAX_SCHEDULE][MAX_AGENTS];
+
+/***** Queue instrumentation *****/
+
+// Root queue disc of the devices (see --queueDisc) and the queues of each station (device indices - 1)
+std::string queueDisc = "fifo";
+std::vector<StationQueueStats> queueStats;
+
+/***** Rolling metrics *****/
+
+// Per-station aggregates of the per-step values (device indices - 1), exponentially weighted
+// with metricsAlpha and over the last metricsWindow interactions
+uint32_t metricsWindow = 10;
+double metricsAlpha = 0.2;
+std::vector<RollingMetric> rollingThroughput;
+std::vector<RollingMetric> rollingCollisionRatio;
+std::vector<RollingMetric> rollingPlr;
+IncrementalJain ewmaFairness;
+IncrementalJain windowFairness;
+
+/***** Dataset generation *****/
+
+// Built-in behaviour policy choosing the CW of the cheaters instead of the agents (see --behaviourPolicy)
+std::string behaviourPolicy = "none";
+uint32_t policyArms = 11;          // CW indices 0..policyArms-1, CW = 2 ^ index
+uint32_t policyDefaultArm = 4;     // the default CWmin 15 is closest to 2 ^ 4
+double policyEpsilon = 0.1;
+uint32_t policySpread = 2;         // epsilon-around-default explores up to this many arms away
+uint32_t policySweepHold = 4;      // interactions each arm is held in the sweep
+Ptr<UniformRandomVariable> policyRng;
+
+uint32_t policyStep = 0;
+std::vector<TransitionRecord> pendingTransitions;
+TransitionWriter datasetWriter;
+
+/***** Frozen policy *****/
+
+// Greedy actions of trained agents executed instead of the agents (see --policyPath)
+FrozenPolicy frozenPolicy;
+
+/***** Collision attribution *****/
+
+// Failed receptions at the AP attributed to the transmitters active during the failed frame,
+// collisionMatrix[victim * nDevices + interferer] with device indices (0 - AP). Both the frames
+// dropped in the preamble or header and the payloads failing on SINR are counted, failures
+// without any overlapping transmitter are not collisions and are left out.
+bool trackCollisions = false;
+uint32_t nDevices = 0;
+std::vector<uint32_t> activeTransmitters;
+std::vector<std::vector<uint32_t>> frameOverlaps;   // transmitters overlapping the last frame of each device
+std::vector<bool> frameAttributed;                   // MPDUs of an A-MPDU are dropped one by one
+std::unordered_map<uint64_t, uint32_t> deviceByAddress;
+
+std::vector<uint64_t> collisionMatrix;               // since the warmup end
+std::vector<uint64_t> windowCollisionMatrix;         // since the last interaction
+std::vector<uint32_t> windowCollisionCells;          // non-zero cells of the window matrix
+std::ofstream collisionWindowFile;
+
+/***** Live telemetry *****/
+
+// Snapshots of the running simulation served on a Unix-domain socket (see --telemetryPath)
+TelemetryServer telemetry;
+double telemetryInterval = 0.1;
+std::chrono::steady_clock::time_point telemetryWallTime;
+double telemetrySimTime = 0.;
+uint64_t telemetryEvents = 0;
+std::vector<double> telemetryRxBytes;
+
+/***** Frame event ring *****/
+
+// Frame-level events pushed to a shared memory ring for live consumers (see --eventRingName)
+EventRing eventRing;
+std::vector<Ptr<QosTxop>> eventTxops;
+std::vector<uint8_t> eventLastMcs;   // MCS of the last data frame of each device
+
+/***** Memory usage *****/
+
+// Memory budget (MB) and the sampling interval of the memory usage and queue occupancy (s)
+double memoryBudget = 0.;
+double memoryInterval = 0.;
+
+// Once the process reaches this fraction of the budget, the collectors are bounded
+const double MEMORY_BUDGET_MARGIN = 0.8;
+
+bool memoryBounded = false;
+double memoryBoundTime = -1.;
+int64_t peakQdiscPackets = -1;     // -1 - not sampled
+int64_t peakMacQueuePackets = -1;
+
+// CSV log streamed to the file instead of kept in memory after the collectors are bounded
+std::ofstream csvLogFile;
+
+/***** AP-side misbehaviour detector *****/
+
+// Per-station estimate of the backoff drawn before each frame received at the AP.
+// Backoff is measured in idle slots the AP observed since the previous frame of the
+// station, which is an upper bound of the slots the station itself counted down.
+struct BackoffEstimate
+{
+  bool seen = false;
+  double idleSlotsAtLastTx = 0.;
+  uint32_t samples = 0;
+  double meanBackoff = 0.;          // EWMA (slots)
+  double varBackoff = 0.;           // EWMA of squared deviation (slots^2)
+  uint32_t histogram[16] = {};      // log2 buckets of the observed backoff
+  double misbehaviourStart = -1.;   // ground truth - CW set below the advertised one
+  double flagTime = -1.;
+  double timeToDetect = -1.;
+  bool falsePositive = false;
+};
+
+bool useDetector = false;
+double detectorThreshold = 0.5;
+uint32_t detectorMinSamples = 20;
+double detectorAlpha = 0.05;
+
+uint32_t advertisedCwMin = 15;
+uint32_t advertisedAifsn = 3;
+Time detectorSlot = MicroSeconds (9);
+Time detectorAifs = MicroSeconds (43);
+
+double totalIdleSlots = 0.;
+std::vector<BackoffEstimate> backoffEstimates;
+std::unordered_map<uint64_t, uint32_t> stationByAddress;
+
+uint64_t
+BytesToKey (const uint8_t *buffer)
+{
+  uint64_t key = 0;
+  for (int i = 0; i < 6; i++)
+    {
+      key = (key << 8) | buffer[i];
+    }
+  return key;
+}
+
+uint64_t
+MacToKey (Mac48Address address)
+{
+  uint8_t buffer[6];
+  address.CopyTo (buffer);
+  return BytesToKey (buffer);
+}
+
+/***** Setup timing *****/
+
+std::chrono::high_resolution_clock::time_point setupStepStart;
+std::vector<std::pair<std::string, double>> setupTimings;
+
+void
+RecordSetupStep (std::string stepName)
+{
+  auto now = std::chrono::high_resolution_clock::now ();
+  std::chrono::duration<double> elapsed = now - setupStepStart;
+  setupTimings.push_back ({stepName, elapsed.count ()});
+  setupStepStart = now;
+}
+
 /***** Main with scenario definition *****/
 
 int
@@ -173,56 +445,243 @@ main (int argc, char *argv[])
   std::string csvPath = "results.csv";
   std::string csvLogPath = "logs.csv";
   std::string flowmonPath = "flowmon.xml";
+  bool flowMonitor = false;
+  std::string setupTimingPath = "";
+  std::string scheduler = "Map";
+  std::string profilePath = "";
+  std::string interactionTracePath = "";
+  std::string telemetryPath = "";
+  std::string eventRingName = "";
+  uint32_t eventRingCapacity = 65536;
+  std::string datasetPath = "dataset.bin";
+  std::string collisionMatrixPath = "";
+  std::string collisionWindowPath = "";
+  std::string resultCache = "";
+  std::string agentIdentity = "";
+  bool forceRun = false;
+  std::string actionDims = "cw";
+  std::string policyPath = "";
 
   int cw_idx = -1;
   bool rts_cts = false;
   bool ampdu = true;
+  bool printPositions = true;
+  std::string ofdma = "none";
+  std::string detectorPath = "detector.csv";
 
   // Parse command line arguments
   CommandLine cmd;
+  cmd.AddValue ("actionDims", "Comma separated action dimensions controlled by the agents (cw,aifsn,txop,ampdu,rts)", actionDims);
+  cmd.AddValue ("agentIdentity", "Implementation and parameters of the agent, part of the result cache key", agentIdentity);
   cmd.AddValue ("agentName", "Name of the agent", agentName);
-  cmd.AddValue ("ampdu", "Enable A-MPDU (only for wifi agent)", ampdu);
+  cmd.AddValue ("ampdu", "Enable A-MPDU", ampdu);
+  cmd.AddValue ("behaviourPolicy", "Generate a transition dataset with a built-in policy instead of the agents (none, random, epsilon, sweep)", behaviourPolicy);
   cmd.AddValue ("channelWidth", "Channel width (MHz)", channelWidth);
+  cmd.AddValue ("collisionMatrixPath", "Path to output CSV matrix of failed receptions at the AP per victim and interferer (empty - disabled)", collisionMatrixPath);
+  cmd.AddValue ("collisionWindowPath", "Path to output CSV of the collision matrix entries of every interaction window (empty - disabled)", collisionWindowPath);
+  cmd.AddValue ("crnRun", "Common random numbers: draw positions, traffic and the stations other than the first cheaterNumber from this run instead of RngRun (-1 - disabled)", crnRun);
   cmd.AddValue ("csvLogPath", "Path to output CSV log file", csvLogPath);
   cmd.AddValue ("csvPath", "Path to output CSV file", csvPath);
+  cmd.AddValue ("detector", "Enable the AP-side low-CW station detector", useDetector);
+  cmd.AddValue ("detectorMinSamples", "Backoff samples needed before a station can be flagged", detectorMinSamples);
+  cmd.AddValue ("detectorPath", "Path to output per-station detector CSV file", detectorPath);
+  cmd.AddValue ("detectorThreshold", "Flag a station if its estimated CW is below this fraction of the advertised CWmin", detectorThreshold);
+  cmd.AddValue ("datasetPath", "Path to output binary transition dataset of the behaviour policy", datasetPath);
   cmd.AddValue ("cw", "Contention window (const CW = 2 ^ (4 + x) if x >= 0) (only for wifi agent)", cw_idx);
   cmd.AddValue ("dataRate", "Traffic generator data rate (Mb/s)", dataRate);
   cmd.AddValue ("distance", "Max distance between AP and STAs (m)", distance);
+  cmd.AddValue ("eventRingCapacity", "Records in the frame event ring (rounded up to a power of two)", eventRingCapacity);
+  cmd.AddValue ("eventRingName", "POSIX shared memory name of the frame event ring (empty - disabled)", eventRingName);
+  cmd.AddValue ("flowMonitor", "Install FlowMonitor on all nodes and save its XML to flowmonPath", flowMonitor);
   cmd.AddValue ("flowmonPath", "Path to output flow monitor XML file", flowmonPath);
+  cmd.AddValue ("forceRun", "Simulate even if the result cache has the results", forceRun);
   cmd.AddValue ("fuzzTime", "Maximum fuzz value (s)", fuzzTime);
   cmd.AddValue ("interactionTime", "Time between agent actions (s)", interactionTime);
+  cmd.AddValue ("infra", "Infrastructure BSS (AP and associated stations) instead of an ad hoc network", infraMode);
+  cmd.AddValue ("interactionTracePath", "Path to output per-step CSV trace of the agent interaction phases (empty - disabled)", interactionTracePath);
   cmd.AddValue ("maxQueueSize", "Max queue size (packets)", maxQueueSize);
+  cmd.AddValue ("memoryBudget", "Bound the memory-hungry collectors before the process reaches this RSS (MB) (0 - disabled)", memoryBudget);
+  cmd.AddValue ("memoryInterval", "Interval of the memory usage and peak queue occupancy sampling (s) (0 - every 1 s with a memory budget, disabled otherwise)", memoryInterval);
+  cmd.AddValue ("metricsAlpha", "Smoothing factor of the exponentially weighted metrics of the stations", metricsAlpha);
+  cmd.AddValue ("metricsWindow", "Number of interactions of the sliding-window metrics of the stations", metricsWindow);
   cmd.AddValue ("nWifi", "Number of stations", nWifi);
+  cmd.AddValue ("ofdma", "OFDMA multi-user scheduler of the AP in the infrastructure mode (none, dl, ul - DL and UL)", ofdma);
   cmd.AddValue ("packetSize", "Packets size (B)", packetSize);
   cmd.AddValue ("pcapName", "Name of a PCAP file generated from the AP", pcapName);
-  cmd.AddValue ("rtsCts", "Enable RTS/CTS (only for wifi agent)", rts_cts);
+  cmd.AddValue ("policyArms", "Number of CW indices of the behaviour policy (CW = 2 ^ index)", policyArms);
+  cmd.AddValue ("policyDefaultArm", "CW index the epsilon policy explores around", policyDefaultArm);
+  cmd.AddValue ("policyEpsilon", "Probability of leaving the default CW in the epsilon policy", policyEpsilon);
+  cmd.AddValue ("policySpread", "Max distance (CW indices) of the epsilon policy from the default CW", policySpread);
+  cmd.AddValue ("policyPath", "CSV file with the frozen policy of trained agents, run without the agents (empty - disabled)", policyPath);
+  cmd.AddValue ("policySweepHold", "Interactions each CW is held in the sweep policy", policySweepHold);
+  cmd.AddValue ("printPositions", "Print position of each node", printPositions);
+  cmd.AddValue ("profilePath", "Path to output CSV file with per-callback event counts and wall time (empty - disabled)", profilePath);
+  cmd.AddValue ("queueDisc", "Root queue disc of the devices (fifo, codel, fqcodel)", queueDisc);
+  cmd.AddValue ("resultCache", "Directory of the result cache (empty - disabled)", resultCache);
+  cmd.AddValue ("rtsCts", "Enable RTS/CTS", rts_cts);
+  cmd.AddValue ("scheduler", "Event scheduler implementation (Map, Heap, List, Calendar, PriorityQueue)", scheduler);
+  cmd.AddValue ("setupTimingPath", "Path to CSV file the per-step setup timing is appended to (empty - disabled)", setupTimingPath);
   cmd.AddValue ("simulationTime", "Duration of simulation (s)", simulationTime);
+  cmd.AddValue ("telemetryInterval", "Interval of the live telemetry snapshots (simulated s)", telemetryInterval);
+  cmd.AddValue ("telemetryPath", "Unix-domain socket serving live telemetry as HTTP JSON (empty - disabled)", telemetryPath);
+  cmd.AddValue ("trafficMode", "Traffic of the stations: onoff (constant rate dataRate) or saturation (queues kept full)", trafficMode);
   cmd.AddValue ("cheaterNumber", "Number of cheaters in network", cheaterNumber);
   cmd.Parse (argc, argv);
 
+  if (!policyPath.empty ())
+    {
+      frozenPolicy.Load (policyPath);
+    }
+  bool agentsProcess = behaviourPolicy == "none" && !frozenPolicy.IsLoaded ();
+
+  // Identical configurations are restored from the result cache. Runs asking for wall time
+  // measurements are always simulated. The AP is the first node with a single device, so the
+  // PCAP helper names its trace <pcapName>-0-0.pcap.
+  bool pcapEnabled = !pcapName.empty () && memoryBudget <= 0;
+  CachedFiles cachedFiles = {{"results.csv", csvPath},
+                             {"logs.csv", csvLogPath},
+                             {"flowmon.xml", flowMonitor ? flowmonPath : ""},
+                             {"detector.csv", useDetector ? detectorPath : ""},
+                             {"collision_matrix.csv", collisionMatrixPath},
+                             {"collision_windows.csv", collisionWindowPath},
+                             {"dataset.bin", behaviourPolicy != "none" ? datasetPath : ""},
+                             {"ap.pcap", pcapEnabled ? pcapName + "-0-0.pcap" : ""}};
+  std::string cacheEntry = "";
+  if (!resultCache.empty () && profilePath.empty () && interactionTracePath.empty () && telemetryPath.empty ()
+      && eventRingName.empty () && setupTimingPath.empty ())
+    {
+      std::set<std::string> outputOptions = {"csvPath", "csvLogPath", "flowmonPath", "detectorPath", "setupTimingPath",
+                                             "collisionMatrixPath", "collisionWindowPath", "datasetPath", "pcapName"};
+      cacheEntry = GetConfigurationKey (argc, argv, outputOptions, {"resultCache", "forceRun", "printPositions", "policyPath"});
+
+      // The policy is keyed by its contents, not by the path of the file
+      if (frozenPolicy.IsLoaded ())
+        {
+          Fnv1a hash;
+          hash.Add (cacheEntry + "\npolicy=" + frozenPolicy.GetContents ());
+          cacheEntry = hash.GetHex ();
+        }
+      cacheEntry = resultCache + "/" + cacheEntry;
+
+      if (!forceRun && RestoreCachedResults (cacheEntry, cachedFiles))
+        {
+          std::cout << "Results restored from the cache: " << cacheEntry << std::endl;
+
+          // The agents' process waits for the end of the simulation
+          if (agentsProcess)
+            {
+              m_env = new Ns3AIRL<sEnv, sAct> (DEFAULT_MEMBLOCK_KEY);
+              m_env->SetFinish ();
+            }
+          return 0;
+        }
+    }
+
+  // Select the event scheduler, optionally wrapped in the profiler
+  ObjectFactory schedulerFactory;
+  if (profilePath.empty ())
+    {
+      schedulerFactory.SetTypeId ("ns3::" + scheduler + "Scheduler");
+    }
+  else
+    {
+      schedulerFactory.SetTypeId ("ns3::ProfilingScheduler");
+      schedulerFactory.Set ("InnerScheduler", StringValue ("ns3::" + scheduler + "Scheduler"));
+    }
+  Simulator::SetScheduler (schedulerFactory);
+
+  if (trafficMode != "onoff" && trafficMode != "saturation")
+    {
+      NS_FATAL_ERROR ("Unknown traffic mode: " << trafficMode);
+    }
+  if (behaviourPolicy != "none" && behaviourPolicy != "random" && behaviourPolicy != "epsilon"
+      && behaviourPolicy != "sweep")
+    {
+      NS_FATAL_ERROR ("Unknown behaviour policy: " << behaviourPolicy);
+    }
+  if (behaviourPolicy != "none" && frozenPolicy.IsLoaded ())
+    {
+      NS_FATAL_ERROR ("A behaviour policy cannot be used together with a frozen policy");
+    }
+  if (policyArms == 0 || policyDefaultArm >= policyArms)
+    {
+      NS_FATAL_ERROR ("The default arm must be one of " << policyArms << " policy arms");
+    }
+  if (ofdma != "none" && ofdma != "dl" && ofdma != "ul")
+    {
+      NS_FATAL_ERROR ("Unknown OFDMA mode: " << ofdma);
+    }
+  if (queueDisc != "fifo" && queueDisc != "codel" && queueDisc != "fqcodel")
+    {
+      NS_FATAL_ERROR ("Unknown queue disc: " << queueDisc);
+    }
+  if (ofdma != "none" && !infraMode)
+    {
+      NS_FATAL_ERROR ("OFDMA requires the infrastructure mode (--infra)");
+    }
+  if (cheaterNumber < 0 || cheaterNumber > MAX_AGENTS)
+    {
+      NS_FATAL_ERROR ("At most " << MAX_AGENTS << " cheaters, got " << cheaterNumber);
+    }
+  CheckStreamLayout (nWifi, nWifi + 1);
+
+  ParseActionDims (actionDims);
+  currentInteractionTime = interactionTime;
+
+  setupStepStart = std::chrono::high_resolution_clock::now ();
+
   // Print simulation settings to screen
   std::cout << std::endl
             << "Simulating an IEEE 802.11ax devices with the following settings:" << std::endl
             << "- agent: " << agentName << std::endl
             << "- frequency band: 5 GHz" << std::endl
             << "- max data rate: " << dataRate << " Mb/s" << std::endl
+            << "- traffic: " << trafficMode << std::endl
             << "- channel width: " << channelWidth << " Mhz" << std::endl
             << "- packets size: " << packetSize << " B" << std::endl
             << "- max queue size: " << maxQueueSize << " packets" << std::endl
+            << "- queue disc: " << queueDisc << std::endl
             << "- number of stations: " << nWifi << std::endl
             << "- max distance between AP and STAs: " << distance << " m" << std::endl
             << "- simulation time: " << simulationTime << " s" << std::endl
             << "- max fuzz time: " << fuzzTime << " s" << std::endl
-            << "- interaction time: " << interactionTime << " s" << std::endl;
-
-  if (agentName == "wifi")
+            << "- interaction time: " << interactionTime << " s" << std::endl
+            << "- common random numbers: " << (crnRun >= 0 ? "run " + std::to_string (crnRun) : "disabled") << std::endl
+            << "- scheduler: " << scheduler << (profilePath.empty () ? "" : " (profiled)") << std::endl
+            << "- RTS/CTS: " << (rts_cts ? "enabled" : "disabled") << std::endl
+            << "- A-MPDU: " << (ampdu ? "enabled" : "disabled") << std::endl
+            << "- BSS: " << (infraMode ? "infrastructure (OFDMA: " + ofdma + ")" : "ad hoc") << std::endl
+            << "- memory budget: " << (memoryBudget > 0 ? std::to_string (memoryBudget) + " MB" : "none") << std::endl;
+
+  if (behaviourPolicy != "none")
+    {
+      std::cout << "- behaviour policy: " << behaviourPolicy << " (" << policyArms << " arms)" << std::endl;
+    }
+  else if (frozenPolicy.IsLoaded ())
+    {
+      std::cout << "- frozen policy: " << policyPath << " (" << frozenPolicy.GetNAgents () << " agents)" << std::endl;
+    }
+  else if (agentName == "wifi")
+    {
+      std::cout << "- CW: " << (cw_idx >= 0 ? "2 ^ (4 + " + std::to_string (cw_idx) + ")" : "default" ) << std::endl;
+    }
+  else
     {
-      std::cout << "- CW: " << (cw_idx >= 0 ? "2 ^ (4 + " + std::to_string (cw_idx) + ")" : "default" ) << std::endl
-                << "- RTS/CTS: " << (rts_cts ? "enabled" : "disabled") << std::endl
-                << "- A-MPDU: " << (ampdu ? "enabled" : "disabled") << std::endl;
+      std::cout << "- action dimensions: " << actionDims << std::endl;
     }
 
-  useMabAgent = agentName != "wifi";
+  useMabAgent = agentName != "wifi" && agentsProcess;
+  if (agentsProcess)
+    {
+      m_env = new Ns3AIRL<sEnv, sAct> (DEFAULT_MEMBLOCK_KEY);
+    }
+  else if (behaviourPolicy != "none")
+    {
+      policyRng = CreateObject<UniformRandomVariable> ();
+      policyRng->SetStream (POLICY_STREAM);
+      pendingTransitions.resize (cheaterNumber);
+      datasetWriter.Open (datasetPath);
+    }
 
   // Create AP and stations
   NodeContainer wifiApNode (1);
@@ -230,10 +689,15 @@ main (int argc, char *argv[])
 
   // Configure mobility model
   MobilityHelper mobility;
-  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
-                                 "X", DoubleValue (0.0),
-                                 "Y", DoubleValue (0.0),
-                                 "rho", DoubleValue (distance));
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetX (0.0);
+  positionAllocator->SetY (0.0);
+  positionAllocator->SetRho (distance);
+  {
+    ScopedRngRun environmentRun (crnRun);
+    positionAllocator->AssignStreams (MOBILITY_STREAM);
+  }
+  mobility.SetPositionAllocator (positionAllocator);
 
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
   mobility.Install (wifiApNode);
@@ -244,78 +708,167 @@ main (int argc, char *argv[])
   apMobility->SetPosition (Vector (0.0, 0.0, 0.0));
 
   // Print position of each node
-  std::cout << std::endl << "Node positions:" << std::endl;
+  if (printPositions)
+    {
+      std::cout << std::endl << "Node positions:" << std::endl;
 
-  // AP position
-  Ptr<MobilityModel> position = wifiApNode.Get (0)->GetObject<MobilityModel> ();
-  Vector pos = position->GetPosition ();
-  std::cout << "AP:\tx=" << pos.x << ", y=" << pos.y << std::endl;
+      // AP position
+      Vector pos = apMobility->GetPosition ();
+      std::cout << "AP:\tx=" << pos.x << ", y=" << pos.y << std::endl;
 
-  // Stations positions
-  for (auto node = wifiStaNodes.Begin (); node != wifiStaNodes.End (); ++node)
-    {
-      position = (*node)->GetObject<MobilityModel> ();
-      pos = position->GetPosition ();
-      std::cout << "Sta " << (*node)->GetId () << ":\tx=" << pos.x << ", y=" << pos.y << std::endl;
+      // Stations positions
+      for (auto node = wifiStaNodes.Begin (); node != wifiStaNodes.End (); ++node)
+        {
+          pos = (*node)->GetObject<MobilityModel> ()->GetPosition ();
+          std::cout << "Sta " << (*node)->GetId () << ":\tx=" << pos.x << ", y=" << pos.y << std::endl;
+        }
+
+      std::cout << std::endl;
     }
 
-  std::cout << std::endl;
+  RecordSetupStep ("nodes and mobility");
 
   // Configure wireless channel
   YansWifiPhyHelper phy;
   YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
-  phy.SetChannel (channelHelper.Create ());
+  Ptr<YansWifiChannel> channel = channelHelper.Create ();
+  {
+    ScopedRngRun environmentRun (crnRun);
+    channelHelper.AssignStreams (channel, CHANNEL_STREAM);
+  }
+  phy.SetChannel (channel);
+
+  // Set channel width on the helper, so that every PHY is created with it
+  phy.Set ("ChannelSettings", StringValue ("{0, " + std::to_string (channelWidth) + ", BAND_5GHZ, 0}"));
 
   // Configure MAC layer
   
   WifiHelper wifi;
   WifiMacHelper mac;
   wifi.SetStandard (WIFI_STANDARD_80211ax);
-  wifi.SetRemoteStationManager ("ns3::IdealWifiManager");
-
-  mac.SetType("ns3::AdhocWifiMac");
+  if (rts_cts)
+    {
+      wifi.SetRemoteStationManager ("ns3::IdealWifiManager", "RtsCtsThreshold", UintegerValue (0));
+    }
+  else
+    {
+      wifi.SetRemoteStationManager ("ns3::IdealWifiManager");
+    }
 
   // Set SSID
   Ssid ssid = Ssid ("ns3-80211ax");
-  // mac.SetType ("ns3::StaWifiMac",
-  //              "Ssid", SsidValue (ssid),
-  //              "MaxMissedBeacons", UintegerValue (1000)); // prevents exhaustion of association IDs
 
   // Create and configure Wi-Fi interfaces
-
   NetDeviceContainer apDevice;
-  apDevice = wifi.Install (phy, mac, wifiApNode);
-
   NetDeviceContainer staDevice;
-  staDevice = wifi.Install (phy, mac, wifiStaNodes);
 
+  if (infraMode)
+    {
+      mac.SetType ("ns3::ApWifiMac", "Ssid", SsidValue (ssid));
+      if (ofdma != "none")
+        {
+          // UL OFDMA needs the AP to win the channel periodically to solicit the stations
+          mac.SetMultiUserScheduler ("ns3::RrMultiUserScheduler",
+                                     "EnableUlOfdma", BooleanValue (ofdma == "ul"),
+                                     "EnableBsrp", BooleanValue (ofdma == "ul"),
+                                     "AccessReqInterval", TimeValue (ofdma == "ul" ? MilliSeconds (2) : Seconds (0)));
+        }
+      apDevice = wifi.Install (phy, mac, wifiApNode);
 
-  
-  // Set channel width
-  Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/ChannelSettings",
-               StringValue ("{0, " + std::to_string (channelWidth) + ", BAND_5GHZ, 0}"));
+      mac.SetType ("ns3::StaWifiMac",
+                   "Ssid", SsidValue (ssid),
+                   "MaxMissedBeacons", UintegerValue (1000)); // prevents exhaustion of association IDs
+      staDevice = wifi.Install (phy, mac, wifiStaNodes);
+    }
+  else
+    {
+      mac.SetType("ns3::AdhocWifiMac");
+
+      if (!ampdu)
+        {
+          mac.SetType ("ns3::AdhocWifiMac", "BE_MaxAmpduSize", UintegerValue (0));
+        }
+
+      apDevice = wifi.Install (phy, mac, wifiApNode);
+      staDevice = wifi.Install (phy, mac, wifiStaNodes);
+    }
+
+  // Keep direct handles to the devices, so that nothing below has to resolve Config paths
+  wifiDevices.reserve (nWifi + 1);
+  wifiDevices.push_back (DynamicCast<WifiNetDevice> (apDevice.Get (0)));
+  for (uint32_t j = 0; j < staDevice.GetN (); ++j)
+    {
+      wifiDevices.push_back (DynamicCast<WifiNetDevice> (staDevice.Get (j)));
+    }
+
+  // Give every device its own block of streams. The first cheaterNumber stations always draw from RngRun,
+  // whichever agent, frozen policy or the wifi baseline runs them, so that all of them share the environment.
+  for (uint32_t j = 0; j < wifiDevices.size (); ++j)
+    {
+      ScopedRngRun environmentRun (j >= 1 && j <= (uint32_t) cheaterNumber ? -1 : crnRun);
+      AssignDeviceStreams (wifi, wifiDevices[j], j);
+    }
+
+  edcaOverrides.resize (nWifi + 1);
+  if (infraMode)
+    {
+      pendingSources.resize (nWifi);
+      stationAssociated.assign (nWifi, false);
+
+      for (uint32_t j = 1; j <= nWifi; ++j)
+        {
+          Ptr<WifiMac> staMac = wifiDevices[j]->GetMac ();
+          if (!ampdu)
+            {
+              staMac->SetAttribute ("BE_MaxAmpduSize", UintegerValue (0));
+            }
+          staMac->TraceConnectWithoutContext ("Assoc", MakeBoundCallback (&StationAssociated, j - 1));
+          staMac->TraceConnectWithoutContext ("BeaconArrival", MakeBoundCallback (&StationBeacon, j - 1));
+        }
+      if (!ampdu)
+        {
+          wifiDevices[0]->GetMac ()->SetAttribute ("BE_MaxAmpduSize", UintegerValue (0));
+        }
+    }
+
+  RecordSetupStep ("wifi devices");
 
   // Install an Internet stack
   InternetStackHelper stack;
   stack.Install (wifiApNode);
   stack.Install (wifiStaNodes);
 
+  RecordSetupStep ("internet stack");
+
   TrafficControlHelper tch;
-  tch.SetRootQueueDisc("ns3::FifoQueueDisc", "MaxSize",  StringValue(std::to_string(maxQueueSize)+"p"));
-  tch.Install(apDevice);
-  tch.Install(staDevice);
-  
+  std::string queueDiscType = queueDisc == "codel" ? "ns3::CoDelQueueDisc"
+                               : queueDisc == "fqcodel" ? "ns3::FqCoDelQueueDisc" : "ns3::FifoQueueDisc";
+  tch.SetRootQueueDisc(queueDiscType, "MaxSize",  StringValue(std::to_string(maxQueueSize)+"p"));
+  queueDiscs.Add (tch.Install (apDevice));
+  queueDiscs.Add (tch.Install (staDevice));
+
+  RecordSetupStep ("traffic control");
 
   // Configure IP addressing
-  Ipv4AddressHelper address ("192.168.1.0", "255.255.255.0");
+  // A /16 network leaves room for the large-scale runs (over 253 stations)
+  Ipv4AddressHelper address ("192.168.0.0", "255.255.0.0");
   Ipv4InterfaceContainer apNodeInterface = address.Assign (apDevice);
   Ipv4InterfaceContainer staNodeInterface = address.Assign (staDevice);
-  
+
+  RecordSetupStep ("ip addressing");
 
   // PopulateArpCache
   PopulateARPcache ();
 
+  RecordSetupStep ("arp cache");
+
   // Configure applications
+  appMetrics.Resize (nWifi);
+  previousStats = appMetrics.GetAll ();
+  scheduleStats = previousStats;
+  windowLatency.resize (nWifi);
+  runLatency.resize (nWifi);
+
   DataRate applicationDataRate = DataRate (dataRate * 1e6);
   uint32_t portNumber = 9;
 
@@ -323,22 +876,76 @@ main (int argc, char *argv[])
   // Config::Connect ("/NodeList/"+ std::to_string(0) +"/DeviceList/*/$ns3::WifiNetDevice/Mac/MacRx", MakeCallback(&IpCheck));
   
   // callbacks conf
+  global_drop_list.assign (nWifi, 0.);
+  previous_global_drop_list.assign (nWifi, 0.);
+  rollingThroughput.assign (nWifi, RollingMetric ());
+  rollingCollisionRatio.assign (nWifi, RollingMetric ());
+  rollingPlr.assign (nWifi, RollingMetric ());
+  for (uint32_t j = 0; j < nWifi; j++)
+    {
+      rollingThroughput[j].Configure (metricsWindow, metricsAlpha);
+      rollingCollisionRatio[j].Configure (metricsWindow, metricsAlpha);
+      rollingPlr[j].Configure (metricsWindow, metricsAlpha);
+    }
+  ewmaFairness.Resize (nWifi);
+  windowFairness.Resize (nWifi);
+  queueStats.assign (nWifi, StationQueueStats ());
   for (uint32_t j = 0; j < wifiStaNodes.GetN (); ++j)
     {
       InstallTrafficGenerator (wifiStaNodes.Get (j), wifiApNode.Get (0), portNumber++,
-                               applicationDataRate, packetSize);
-      global_drop_list[j] = 0;
-      previous_global_drop_list[j] = 0;
-      Config::Connect ("/NodeList/"+ std::to_string(j+1) +"/DeviceList/*/$ns3::WifiNetDevice/Mac/MacTx", MakeCallback(&MonitorRetransmissions));
+                               applicationDataRate, packetSize, j);
+      wifiDevices[j + 1]->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&MonitorRetransmissions, j + 1));
+
+      // The queue discs are installed on the AP first
+      queueDiscs.Get (j + 1)->TraceConnectWithoutContext ("SojournTime", MakeBoundCallback (&QdiscSojourn, j));
+      queueDiscs.Get (j + 1)->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&QdiscDrop, j));
+      Ptr<WifiMacQueue> macQueue = wifiDevices[j + 1]->GetMac ()->GetTxopQueue (AC_BE);
+      macQueue->TraceConnectWithoutContext ("Dequeue", MakeBoundCallback (&MacQueueDequeue, j, macQueue->GetMaxDelay ()));
+      macQueue->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&MacQueueDrop, j));
+    }
+
+  // Frames of the stations are pushed to the event ring, an acknowledged MPDU is a reception at the AP
+  if (!eventRingName.empty ())
+    {
+      eventRing.Open (eventRingName, eventRingCapacity);
+      eventTxops.assign (wifiDevices.size (), nullptr);
+      eventLastMcs.assign (wifiDevices.size (), 0);
+      for (uint32_t j = 1; j < wifiDevices.size (); ++j)
+        {
+          Ptr<WifiMac> mac = wifiDevices[j]->GetMac ();
+          eventTxops[j] = mac->GetQosTxop (AC_BE);
+          wifiDevices[j]->GetPhy ()->TraceConnectWithoutContext ("PhyTxPsduBegin", MakeBoundCallback (&EventTxBegin, j));
+          mac->TraceConnectWithoutContext ("AckedMpdu", MakeBoundCallback (&EventAcked, j));
+          mac->TraceConnectWithoutContext ("DroppedMpdu", MakeBoundCallback (&EventDropped, j));
+        }
+      std::cout << "Frame events published in shared memory: " << eventRingName << std::endl;
     }
 
-  // Install FlowMonitor
+  RecordSetupStep ("applications and traces");
+
+  // Install FlowMonitor (the metrics come from the applications, it only adds the XML output)
   FlowMonitorHelper flowmon;
-  monitor = flowmon.InstallAll ();
+  if (flowMonitor)
+    {
+      if (memoryBudget > 0)
+        {
+          // Coarser histograms keep the number of bins of long runs small
+          flowmon.SetMonitorAttribute ("DelayBinWidth", DoubleValue (0.01));
+          flowmon.SetMonitorAttribute ("JitterBinWidth", DoubleValue (0.01));
+          flowmon.SetMonitorAttribute ("PacketSizeBinWidth", DoubleValue (100));
+        }
+      monitor = flowmon.InstallAll ();
+    }
   csvLogOutput << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,time" << std::endl;
 
-  // Generate PCAP at AP
-  if (!pcapName.empty ())
+  RecordSetupStep ("flow monitor");
+
+  // Generate PCAP at AP (the helper cannot detach it later, so it is not used with a memory budget)
+  if (!pcapName.empty () && !pcapEnabled)
+    {
+      std::cout << "PCAP disabled because of the memory budget" << std::endl;
+    }
+  else if (pcapEnabled)
     {
       phy.SetPcapDataLinkType (WifiPhyHelper::DLT_IEEE802_11_RADIO);
       phy.EnablePcap (pcapName, apDevice);
@@ -350,10 +957,112 @@ main (int argc, char *argv[])
       SetNetworkConfiguration (cw_idx);
     }
 
-  m_env->SetCond (2, 0);
+  // The AP EDCA parameters are the reference for the detector
+  if (useDetector)
+    {
+      Ptr<WifiPhy> apPhy = wifiDevices[0]->GetPhy ();
+      Ptr<QosTxop> apTxop = wifiDevices[0]->GetMac ()->GetQosTxop (AC_BE);
+      advertisedCwMin = apTxop->GetMinCw ();
+      advertisedAifsn = apTxop->GetAifsn ();
+      detectorSlot = apPhy->GetSlot ();
+      detectorAifs = apPhy->GetSifs () + advertisedAifsn * apPhy->GetSlot ();
+
+      backoffEstimates.resize (nWifi);
+      for (uint32_t j = 1; j <= nWifi; ++j)
+        {
+          stationByAddress[MacToKey (wifiDevices[j]->GetMac ()->GetAddress ())] = j - 1;
+        }
+
+      apPhy->GetState ()->TraceConnectWithoutContext ("State", MakeCallback (&DetectorPhyState));
+      apPhy->TraceConnectWithoutContext ("MonitorSnifferRx", MakeCallback (&DetectorSnifferRx));
+    }
+
+  // Every PHY reports its transmissions, the AP its failed receptions
+  trackCollisions = !collisionMatrixPath.empty () || !collisionWindowPath.empty ();
+  if (trackCollisions)
+    {
+      nDevices = wifiDevices.size ();
+      frameOverlaps.resize (nDevices);
+      frameAttributed.assign (nDevices, true);
+      collisionMatrix.assign (nDevices * nDevices, 0);
+      windowCollisionMatrix.assign (nDevices * nDevices, 0);
+
+      for (uint32_t j = 0; j < nDevices; ++j)
+        {
+          deviceByAddress[MacToKey (wifiDevices[j]->GetMac ()->GetAddress ())] = j;
+          wifiDevices[j]->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&CollisionTxBegin, j));
+          wifiDevices[j]->GetPhy ()->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&CollisionTxEnd, j));
+        }
+      wifiDevices[0]->GetPhy ()->TraceConnectWithoutContext ("PhyRxDrop", MakeCallback (&CollisionRxDrop));
+      wifiDevices[0]->GetPhy ()->GetState ()->TraceConnectWithoutContext ("RxError", MakeCallback (&CollisionRxError));
+
+      if (!collisionWindowPath.empty ())
+        {
+          collisionWindowFile.open (collisionWindowPath);
+          collisionWindowFile << "time,victim,interferer,count" << std::endl;
+        }
+    }
+
+  RecordSetupStep ("pcap and agent configuration");
+
+  // Print setup timing
+  double setupTime = 0.;
+  std::cout << "Setup timing:" << std::endl;
+  for (auto &step : setupTimings)
+    {
+      std::cout << "- " << step.first << ": " << step.second << " s" << std::endl;
+      setupTime += step.second;
+    }
+  std::cout << "- total: " << setupTime << " s" << std::endl << std::endl;
+
+  if (!setupTimingPath.empty ())
+    {
+      bool writeHeader = !std::filesystem::exists (setupTimingPath);
+      std::ofstream setupTimingFile (setupTimingPath, std::ios::app);
+      if (writeHeader)
+        {
+          setupTimingFile << "nWifi,step,time" << std::endl;
+        }
+      for (auto &step : setupTimings)
+        {
+          setupTimingFile << nWifi << "," << step.first << "," << step.second << std::endl;
+        }
+      setupTimingFile << nWifi << ",total," << setupTime << std::endl;
+    }
+
+  if (!interactionTracePath.empty ())
+    {
+      interactionTraceFile.open (interactionTracePath);
+      interactionTraceFile << "step,time,build,publish,wait,agent,apply" << std::endl;
+    }
+
+  if (m_env)
+    {
+      m_env->SetCond (2, 0);
+    }
   Simulator::Schedule (Seconds (fuzzTime), &ResetMonitor);
+  if (infraMode)
+    {
+      Simulator::Schedule (Seconds (fuzzTime), &CheckAssociation);
+    }
+
+  // Sample only when the budget, the peak queue occupancy or the event ring consumers need it
+  if (memoryBudget > 0 || memoryInterval > 0 || eventRing.IsOpen ())
+    {
+      memoryInterval = memoryInterval > 0 ? memoryInterval : 1.;
+      Simulator::ScheduleNow (&MonitorMemory, csvLogPath);
+    }
   Simulator::Schedule (Seconds (fuzzTime), &ExecuteAction, agentName, dataRate, distance, nWifi, cheaterNumber);
 
+  if (!telemetryPath.empty ())
+    {
+      telemetry.Start (telemetryPath);
+      telemetryRxBytes.assign (nWifi, 0.);
+      telemetryWallTime = std::chrono::steady_clock::now ();
+      Simulator::ScheduleNow (&PublishTelemetry, nWifi);
+      std::cout << "Live telemetry served on: " << telemetryPath << std::endl;
+    }
+
   // Record start time
   std::cout << "Starting simulation..." << std::endl;
   auto start = std::chrono::high_resolution_clock::now ();
@@ -364,29 +1073,78 @@ main (int argc, char *argv[])
   // Record stop time and count duration
   auto finish = std::chrono::high_resolution_clock::now ();
   std::chrono::duration<double> elapsed = finish - start;
+  telemetry.Stop ();
+
+  if (eventRing.IsOpen ())
+    {
+      std::cout << "Event ring: " << eventRing.GetPushed () << " records pushed, "
+                << eventRing.GetOverflow () << " dropped" << std::endl;
+      eventRing.Close ();
+    }
+
+  if (datasetWriter.IsOpen ())
+    {
+      datasetWriter.Close ();
+      std::cout << "Dataset of " << datasetWriter.GetRecords () << " transitions saved to: " << datasetPath << std::endl;
+    }
   
 
+  double wallTime = elapsed.count ();
+  uint64_t events = Simulator::GetEventCount ();
+
   std::cout << "Done!" << std::endl
-            << "Elapsed time: " << elapsed.count () << " s" << std::endl
+            << "Elapsed time: " << wallTime << " s" << std::endl
+            << "Events: " << events << " (" << events / wallTime << " events/s, "
+            << events / Simulator::Now ().GetSeconds () << " per simulated s)" << std::endl
             << std::endl;
 
+  // Split the run wall time between the simulator, the agents and the hand-off between them
+  double agentBusy = agentTime.GetMean () * agentTime.GetCount ();
+  double transport = std::max (0., handshakeTime.GetMean () * handshakeTime.GetCount () - agentBusy);
+  double simulatorBusy = std::max (0., wallTime - agentBusy - transport);
+
+  if (interactionStep > 0)
+    {
+      std::cout << "Agent interaction (" << interactionStep << " steps, p50 / p99 / mean):" << std::endl;
+      for (auto &phase : std::vector<std::pair<std::string, LatencyHistogram *>> {
+             {"build", &buildTime}, {"publish", &publishTime}, {"wait", &waitTime},
+             {"agent", &agentTime}, {"apply", &applyTime}, {"handshake", &handshakeTime}})
+        {
+          std::cout << "- " << phase.first << ": " << phase.second->GetPercentile (0.5) << " / "
+                    << phase.second->GetPercentile (0.99) << " / " << phase.second->GetMean () << " s" << std::endl;
+        }
+      std::cout << "Wall time shares: simulator " << simulatorBusy / wallTime << ", agent " << agentBusy / wallTime
+                << ", transport " << transport / wallTime << std::endl << std::endl;
+    }
+
+  if (interactionTraceFile.is_open ())
+    {
+      interactionTraceFile.close ();
+      std::cout << "Interaction trace saved to: " << interactionTracePath << std::endl << std::endl;
+    }
+
+  if (!profilePath.empty ())
+    {
+      ProfilingScheduler::Get ()->Report (profilePath);
+      std::cout << "Event profile saved to: " << profilePath << std::endl << std::endl;
+    }
+
   // Calculate per-flow throughput and Jain's fairness index
   double nWifiReal = 0;
   double jainsIndexN = 0.;
   double jainsIndexD = 0.;
 
-  Time latencySum = Seconds(0);
+  double latencySum = 0.;
   double lostSum = 0.;
   double txSum = 0.;
   double rxSum = 0.;
 
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  const std::vector<FlowCounters> &stats = appMetrics.GetAll ();
   std::cout << "Results: " << std::endl;
 
-  for (auto &stat : stats)
+  for (uint32_t i = 0; i < nWifi; i++)
   {
-    double flow = 8 * stat.second.rxBytes / (1e6 * simulationTime);
+    double flow = 8 * stats[i].rxBytes / (1e6 * simulationTime);
 
     if (flow > 0)
       {
@@ -396,31 +1154,71 @@ main (int argc, char *argv[])
     jainsIndexN += flow;
     jainsIndexD += flow * flow;
 
-    latencySum += stat.second.delaySum;
-    lostSum += stat.second.lostPackets;
-    txSum += stat.second.txPackets;
-    rxSum += stat.second.rxPackets;
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (stat.first);
-    std::cout << "Flow " << stat.first << " (" << t.sourceAddress << " -> "
-              << t.destinationAddress << ")\tThroughput: " << flow << " Mb/s" << std::endl;
+    latencySum += stats[i].delaySum;
+    lostSum += stats[i].lostPackets;
+    txSum += stats[i].txPackets;
+    rxSum += stats[i].rxPackets;
+    std::cout << "Station " << i << "\tThroughput: " << flow << " Mb/s" << std::endl;
   }
 
   double totalThr = jainsIndexN;
   double fairnessIndex = jainsIndexN * jainsIndexN / (nWifiReal * jainsIndexD);
   double totalPLR = lostSum / txSum;
-  double totalLatency = latencySum.GetSeconds();
+  double totalLatency = latencySum;
   double latencyPerPacketTotal = totalLatency / txSum;
+
+  // ns-3 keeps no count of live packets, the uid of a new packet is the number of packets created so far.
+  // Packets still tracked by FlowMonitor are the ones neither received nor declared lost.
+  double peakRss = GetPeakRss ();
+  uint64_t packetsAllocated = Create<Packet> ()->GetUid ();
+  double flowmonTracked = 0.;
+  if (monitor)
+    {
+      for (auto &stat : monitor->GetFlowStats ())
+        {
+          flowmonTracked += std::max (0., (double) stat.second.txPackets - stat.second.rxPackets - stat.second.lostPackets);
+        }
+    }
+  // Failed receptions of the normal stations that overlapped a cheater's transmission
+  double collisionsByCheaters = -1.;
+  if (trackCollisions)
+    {
+      collisionsByCheaters = 0.;
+      for (uint32_t i = cheaterNumber + 1; i <= nWifi; i++)
+        {
+          for (int j = 1; j <= cheaterNumber; j++)
+            {
+              collisionsByCheaters += collisionMatrix[i * nDevices + j];
+            }
+        }
+    }
+
   double normalTHR = 0;
   double cheaterTHR = 0;
   double normalAvgTHR = 0;
   double cheaterAvgTHR = 0;
 
+  // Summarize the detector
+  int detectedCheaters = 0;
+  int falsePositives = 0;
+  double meanTimeToDetect = 0.;
+  for (auto &est : backoffEstimates)
+    {
+      if (est.timeToDetect >= 0)
+        {
+          detectedCheaters++;
+          meanTimeToDetect += est.timeToDetect;
+        }
+      falsePositives += est.falsePositive;
+    }
+  meanTimeToDetect = detectedCheaters > 0 ? meanTimeToDetect / detectedCheaters : -1.;
+
   if (agentName != "wifi") {
     for (int i=1; i <= cheaterNumber; i++) {
-      cheaterTHR += 8 * ( stats[i].rxBytes) / (1e6 * simulationTime);
+      cheaterTHR += 8 * ( stats[i-1].rxBytes) / (1e6 * simulationTime);
     }
     for (uint32_t i=cheaterNumber+1; i <= nWifi; i++) {
-      normalTHR += 8 * ( stats[i].rxBytes) / (1e6 * simulationTime);
+      normalTHR += 8 * ( stats[i-1].rxBytes) / (1e6 * simulationTime);
     }
   
     normalAvgTHR = normalTHR / (nWifi - cheaterNumber);
@@ -442,58 +1240,166 @@ main (int argc, char *argv[])
             << "PLR: " << totalPLR << std::endl
             << "Total Latency: " << totalLatency << std::endl
             << "Latency per packet: " << latencyPerPacketTotal << std::endl
+            << "Latency p50/p95/p99/p99.9: " << networkLatency.GetPercentile (0.5) << " / "
+            << networkLatency.GetPercentile (0.95) << " / " << networkLatency.GetPercentile (0.99) << " / "
+            << networkLatency.GetPercentile (0.999) << " s" << std::endl
             << "Total Lost packets: " << lostSum << std::endl
             << "Total tx packets: " << txSum << std::endl
             << "Total rx packets: " << rxSum << std::endl
+            << std::endl
+            << "Peak RSS: " << peakRss << " MB" << std::endl
+            << "Packets allocated: " << packetsAllocated << std::endl
+            << "FlowMonitor tracked packets: " << flowmonTracked << std::endl
+            << "Peak qdisc / MAC queue packets: " << peakQdiscPackets << " / " << peakMacQueuePackets << std::endl
+            << "Collectors bounded at: " << memoryBoundTime << " s" << std::endl
+            << "Stations associated: " << (infraMode ? std::to_string (associatedStations) + " / " + std::to_string (nWifi) : "ad hoc") << std::endl
+            << std::endl;
+
+  // Queueing of the stations since the warmup end
+  QueueCounters qdiscTotal, macTotal;
+  for (auto &station : queueStats)
+    {
+      for (auto [total, counters] : {std::make_pair (&qdiscTotal, &station.totalQdisc),
+                                     std::make_pair (&macTotal, &station.totalMac)})
+        {
+          total->dequeued += counters->dequeued;
+          total->dropped += counters->dropped;
+          total->sojournSum += counters->sojournSum;
+          total->sojournMax = std::max (total->sojournMax, counters->sojournMax);
+        }
+    }
+  std::cout << "Mean qdisc / MAC queue sojourn: " << qdiscTotal.GetMeanSojourn () << " / " << macTotal.GetMeanSojourn () << " s" << std::endl
+            << "Qdisc / MAC queue drops: " << qdiscTotal.dropped << " / " << macTotal.dropped << std::endl
             << std::endl;
 
   // Gather results in CSV format
   std::ostringstream csvOutput;
-  csvOutput << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,cheaterTHR,cheaterAvgTHR,normalTHR,normalAvgTHR,cheaterNumber"<< std::endl;
+  csvOutput << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,cheaterTHR,cheaterAvgTHR,normalTHR,normalAvgTHR,cheaterNumber,setupTime,detectedCheaters,falsePositives,meanTimeToDetect,latencyP50,latencyP95,latencyP99,latencyP999,peakRss,packetsAllocated,flowmonTracked,peakQdiscPackets,peakMacQueuePackets,memoryBoundTime,scheduler,wallTime,events,simulatorShare,agentShare,transportShare,handshakeP50,handshakeP99,infra,associationTime,trafficMode,collisionsByCheaters,queueDisc,qdiscSojourn,qdiscSojournMax,qdiscDrops,macSojourn,macSojournMax,macDrops"<< std::endl;
   csvOutput << agentName << "," << dataRate << "," << distance << "," << nWifi << "," << nWifiReal << ","
             << RngSeedManager::GetRun () << "," << warmupEndTime << "," << fairnessIndex << ","
             << latencyPerPacketTotal << "," << totalPLR << "," << totalThr << "," 
-            << cheaterTHR << "," << cheaterAvgTHR << "," << normalTHR << "," << normalAvgTHR << "," << cheaterNumber << std::endl;
+            << cheaterTHR << "," << cheaterAvgTHR << "," << normalTHR << "," << normalAvgTHR << "," << cheaterNumber << ","
+            << setupTime << "," << detectedCheaters << "," << falsePositives << "," << meanTimeToDetect << ","
+            << networkLatency.GetPercentile (0.5) << "," << networkLatency.GetPercentile (0.95) << ","
+            << networkLatency.GetPercentile (0.99) << "," << networkLatency.GetPercentile (0.999) << ","
+            << peakRss << "," << packetsAllocated << "," << flowmonTracked << "," << peakQdiscPackets << ","
+            << peakMacQueuePackets << "," << memoryBoundTime << "," << scheduler << "," << wallTime << "," << events << ","
+            << simulatorBusy / wallTime << "," << agentBusy / wallTime << "," << transport / wallTime << ","
+            << handshakeTime.GetPercentile (0.5) << "," << handshakeTime.GetPercentile (0.99) << ","
+            << infraMode << "," << associationTime << "," << trafficMode << "," << collisionsByCheaters << ","
+            << queueDisc << "," << qdiscTotal.GetMeanSojourn () << "," << qdiscTotal.sojournMax << "," << qdiscTotal.dropped << ","
+            << macTotal.GetMeanSojourn () << "," << macTotal.sojournMax << "," << macTotal.dropped << std::endl;
 
   // Print results to files
   std::ofstream outputFile (csvPath);
   outputFile << csvOutput.str ();
   std::cout << std::endl << "Simulation data saved to: " << csvPath;
 
-  std::ofstream outputLogFile (csvLogPath);
-  outputLogFile << csvLogOutput.str ();
+  if (csvLogFile.is_open ())
+    {
+      csvLogFile << csvLogOutput.str ();
+      csvLogFile.close ();
+    }
+  else
+    {
+      std::ofstream outputLogFile (csvLogPath);
+      outputLogFile << csvLogOutput.str ();
+    }
   std::cout << std::endl << "Simulation log saved to: " << csvLogPath << std::endl << std::endl;
 
-  monitor->SerializeToXmlFile (flowmonPath, true, true);
-  std::cout << "Flow monitor data saved to: " << flowmonPath << std::endl;
+  if (monitor)
+    {
+      monitor->SerializeToXmlFile (flowmonPath, true, true);
+      std::cout << "Flow monitor data saved to: " << flowmonPath << std::endl;
+    }
 
 
   for (uint32_t i=0; i < nWifi; i++) {
       std::cout << "Collisions packet " << i << ": " << global_drop_list[i] << std::endl;
-      std::cout << "RX packets " << i << ": " << stats[i+1].rxPackets << std::endl;
-      std::cout << "TX packets " << i << ": " << stats[i+1].txPackets << std::endl;
-      std::cout << "LOST packets " << i << ": " << stats[i+1].lostPackets << std::endl;
+      std::cout << "RX packets " << i << ": " << stats[i].rxPackets << std::endl;
+      std::cout << "TX packets " << i << ": " << stats[i].txPackets << std::endl;
+      std::cout << "LOST packets " << i << ": " << stats[i].lostPackets << std::endl;
+      std::cout << "Latency p50/p95/p99/p99.9 " << i << ": " << runLatency[i].GetPercentile (0.5) << " / "
+                << runLatency[i].GetPercentile (0.95) << " / " << runLatency[i].GetPercentile (0.99) << " / "
+                << runLatency[i].GetPercentile (0.999) << std::endl;
   }
   std::cout << "Collisions packet " << global_collinsions_ap << std::endl;
 
-  // for (uint32_t i = 0; i < wifiStaNodes.GetN(); ++i)
-  // {
-  //     Ptr<NetDevice> device = staDevice.Get(i);
-  //     Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
-  //     Ptr<WifiMac> wifiMac = wifiDevice->GetMac();
+  if (useDetector)
+    {
+      std::ofstream detectorFile (detectorPath);
+      detectorFile << "station,samples,meanBackoff,stdBackoff,estimatedCw,advertisedCw,flagTime,misbehaviourStart,timeToDetect,falsePositive,histogram" << std::endl;
+      for (uint32_t i = 0; i < nWifi; i++)
+        {
+          BackoffEstimate &est = backoffEstimates[i];
+          detectorFile << i << "," << est.samples << "," << est.meanBackoff << "," << std::sqrt (est.varBackoff) << ","
+                       << 2 * est.meanBackoff << "," << advertisedCwMin << "," << est.flagTime << ","
+                       << est.misbehaviourStart << "," << est.timeToDetect << "," << est.falsePositive << ",";
+          for (int k = 0; k < 16; k++)
+            {
+              detectorFile << (k > 0 ? ";" : "") << est.histogram[k];
+            }
+          detectorFile << std::endl;
+        }
+      std::cout << "Detector data saved to: " << detectorPath << std::endl;
+    }
 
-  //     UintegerValue cwMinValue;
-  //     // Wywołanie GetAttribute z referencją do obiektu
-  //     wifiMac->GetAttribute("MinCws", cwMinValue);
-  //     // Pobranie wartości z obiektu UintegerValue
-  //     uint32_t cwMin = cwMinValue.Get();
+  if (collisionWindowFile.is_open ())
+    {
+      collisionWindowFile.close ();
+      std::cout << "Collision windows saved to: " << collisionWindowPath << std::endl;
+    }
 
-  //     std::cout << "CWmin: " << cwMin << std::endl;
+  if (!collisionMatrixPath.empty ())
+    {
+      // Rows - victims, columns - interferers (0 - AP)
+      std::ofstream collisionMatrixFile (collisionMatrixPath);
+      collisionMatrixFile << "victim";
+      for (uint32_t j = 0; j < nDevices; j++)
+        {
+          collisionMatrixFile << "," << j;
+        }
+      collisionMatrixFile << std::endl;
+
+      for (uint32_t i = 0; i < nDevices; i++)
+        {
+          collisionMatrixFile << i;
+          for (uint32_t j = 0; j < nDevices; j++)
+            {
+              collisionMatrixFile << "," << collisionMatrix[i * nDevices + j];
+            }
+          collisionMatrixFile << std::endl;
+        }
+      std::cout << "Collision matrix saved to: " << collisionMatrixPath << std::endl;
+    }
+
+  if (!cacheEntry.empty ())
+    {
+      StoreCachedResults (cacheEntry, cachedFiles);
+      std::cout << "Results stored in the cache: " << cacheEntry << std::endl;
+    }
+
+  // for (uint32_t i = 0; i < wifiStaNodes.GetN(); ++i)
+  // {
+  //     Ptr<NetDevice> device = staDevice.Get(i);
+  //     Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
+  //     Ptr<WifiMac> wifiMac = wifiDevice->GetMac();
+
+  //     UintegerValue cwMinValue;
+  //     // Wywołanie GetAttribute z referencją do obiektu
+  //     wifiMac->GetAttribute("MinCws", cwMinValue);
+  //     // Pobranie wartości z obiektu UintegerValue
+  //     uint32_t cwMin = cwMinValue.Get();
+
+  //     std::cout << "CWmin: " << cwMin << std::endl;
   // }
 
   // Cleanup
   Simulator::Destroy ();
-  m_env->SetFinish ();
+  if (m_env)
+    {
+      m_env->SetFinish ();
+    }
 
   return 0;
 }
@@ -503,47 +1409,268 @@ main (int argc, char *argv[])
 void
 ResetMonitor ()
 {
-  monitor->CheckForLostPackets ();
-  monitor->ResetAllStats ();
-  previousStats = monitor->GetFlowStats ();
+  if (monitor)
+    {
+      monitor->CheckForLostPackets ();
+      monitor->ResetAllStats ();
+    }
+  appMetrics.Reset ();
+  previousStats = appMetrics.GetAll ();
+  scheduleStats = previousStats;
   previousRX = 0;
   previousTX = 0;
   previousLost = 0;
   previousDelay = Seconds(0);
+
+  for (uint32_t i = 0; i < runLatency.size (); i++)
+    {
+      windowLatency[i].Reset ();
+      runLatency[i].Reset ();
+    }
+  networkLatency.Reset ();
+
+  std::fill (collisionMatrix.begin (), collisionMatrix.end (), 0);
+
+  for (auto &station : queueStats)
+    {
+      station.totalQdisc.Reset ();
+      station.totalMac.Reset ();
+    }
+}
+
+void
+QdiscSojourn (uint32_t staIndex, Time sojourn)
+{
+  queueStats[staIndex].windowQdisc.AddSojourn (sojourn.GetSeconds ());
+  queueStats[staIndex].totalQdisc.AddSojourn (sojourn.GetSeconds ());
+}
+
+void
+QdiscDrop (uint32_t staIndex, Ptr<const QueueDiscItem> item)
+{
+  queueStats[staIndex].windowQdisc.AddDrop ();
+  queueStats[staIndex].totalQdisc.AddDrop ();
+}
+
+// Called for the acknowledged MPDUs and, before the drop, for the expired ones. The MPDU
+// entered the queue maxDelay (the MaxDelay of the station's queue) before its expiry time, so
+// no per-MPDU state is kept. An MPDU stays queued until its ack, so the retries are included.
+void
+MacQueueDequeue (uint32_t staIndex, Time maxDelay, Ptr<const WifiMpdu> mpdu)
+{
+  double sojourn = (Simulator::Now () - (mpdu->GetExpiryTime () - maxDelay)).GetSeconds ();
+  queueStats[staIndex].windowMac.AddSojourn (sojourn);
+  queueStats[staIndex].totalMac.AddSojourn (sojourn);
+}
+
+void
+MacQueueDrop (uint32_t staIndex, Ptr<const WifiMpdu> mpdu)
+{
+  queueStats[staIndex].windowMac.AddDrop ();
+  queueStats[staIndex].totalMac.AddDrop ();
+}
+
+void
+EventTxBegin (uint32_t deviceIndex, WifiConstPsduMap psduMap, WifiTxVector txVector, double txPowerW)
+{
+  double now = Simulator::Now ().GetSeconds ();
+  uint16_t cw = eventTxops[deviceIndex]->GetMinCw ();
+
+  for (auto &[staId, psdu] : psduMap)
+    {
+      WifiMode mode = txVector.GetMode (staId);
+      uint8_t mcs = mode.GetModulationClass () >= WIFI_MOD_CLASS_HT ? mode.GetMcsValue () : 0;
+
+      // Every MPDU of an A-MPDU is a record, control frames are not
+      for (auto mpdu = psdu->begin (); mpdu != psdu->end (); ++mpdu)
+        {
+          const WifiMacHeader &header = (*mpdu)->GetHeader ();
+          if (!header.IsQosData ())
+            {
+              continue;
+            }
+          eventLastMcs[deviceIndex] = mcs;
+          eventRing.Push (now, deviceIndex, header.IsRetry () ? EVENT_RETRY : EVENT_TX, mcs, cw, (*mpdu)->GetSize ());
+        }
+    }
+}
+
+void
+EventAcked (uint32_t deviceIndex, Ptr<const WifiMpdu> mpdu)
+{
+  eventRing.Push (Simulator::Now ().GetSeconds (), deviceIndex, EVENT_RX, eventLastMcs[deviceIndex],
+                  eventTxops[deviceIndex]->GetMinCw (), mpdu->GetSize ());
+}
+
+void
+EventDropped (uint32_t deviceIndex, WifiMacDropReason reason, Ptr<const WifiMpdu> mpdu)
+{
+  eventRing.Push (Simulator::Now ().GetSeconds (), deviceIndex, EVENT_DROP, eventLastMcs[deviceIndex],
+                  eventTxops[deviceIndex]->GetMinCw (), mpdu->GetSize ());
+}
+
+void
+SinkRxWithSeqTs (uint32_t staIndex, Ptr<const Packet> packet, const Address &from,
+                 const Address &to, const SeqTsSizeHeader &header)
+{
+  Time delay = Simulator::Now () - header.GetTs ();
+  appMetrics.RecordRx (staIndex, header.GetSize (), header.GetSeq (), delay.GetSeconds ());
+  windowLatency[staIndex].Record (delay.GetNanoSeconds ());
+  runLatency[staIndex].Record (delay.GetNanoSeconds ());
+  networkLatency.Record (delay.GetNanoSeconds ());
+}
+
+void
+SourceTx (uint32_t staIndex, Ptr<const Packet> packet)
+{
+  appMetrics.RecordTx (staIndex, packet->GetSize ());
 }
 
 void
 InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_t port,
-                         DataRate offeredLoad, uint32_t packetSize)
+                         DataRate offeredLoad, uint32_t packetSize, uint32_t staIndex)
 {
   // Get sink address
   Ptr<Ipv4> ipv4 = toNode->GetObject<Ipv4> ();
   Ipv4Address addr = ipv4->GetAddress (1, 0).GetLocal ();
 
-  // Define type of service
-  uint8_t tosValue = 0x70; //AC_BE
-
-  // Add random fuzz to app start time
+  // Add random fuzz to app start time, from a stream of the station
+  ScopedRngRun environmentRun (crnRun);
   Ptr<UniformRandomVariable> fuzz = CreateObject<UniformRandomVariable> ();
   fuzz->SetAttribute ("Min", DoubleValue (0.));
   fuzz->SetAttribute ("Max", DoubleValue (fuzzTime));
-  fuzz->SetStream (0);
+  fuzz->SetStream (FUZZ_STREAM + staIndex);
   double applicationsStart = fuzz->GetValue ();
 
   // Configure source and sink
   InetSocketAddress sinkSocket (addr, port);
   PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket);
-
-  OnOffHelper onOffHelper ("ns3::UdpSocketFactory", sinkSocket);
-  onOffHelper.SetConstantRate (offeredLoad, packetSize);
-  onOffHelper.SetAttribute("Tos", UintegerValue(tosValue));
+  packetSinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
 
   // Configure applications
   ApplicationContainer sinkApplications (packetSinkHelper.Install (toNode));
-  ApplicationContainer sourceApplications (onOffHelper.Install (fromNode));
-
+  sinkApplications.Get (0)->TraceConnectWithoutContext ("RxWithSeqTsSize", MakeBoundCallback (&SinkRxWithSeqTs, staIndex));
   sinkApplications.Start (Seconds (applicationsStart));
-  sourceApplications.Start (Seconds (applicationsStart));
+
+  // A station of an infrastructure BSS drops everything it sends before it is associated,
+  // so its source is installed on the association
+  if (infraMode)
+    {
+      pendingSources[staIndex] = [=] () {
+        InstallTrafficSource (fromNode, sinkSocket, offeredLoad, packetSize, staIndex, applicationsStart);
+      };
+    }
+  else
+    {
+      InstallTrafficSource (fromNode, sinkSocket, offeredLoad, packetSize, staIndex, applicationsStart);
+    }
+}
+
+void
+InstallTrafficSource (Ptr<ns3::Node> fromNode, InetSocketAddress sinkSocket, DataRate offeredLoad,
+                      uint32_t packetSize, uint32_t staIndex, double start)
+{
+  // Define type of service
+  uint8_t tosValue = 0x70; //AC_BE
+
+  ApplicationContainer sourceApplications;
+  if (trafficMode == "saturation")
+    {
+      // Refilled from the dequeues of the station's queue disc, which feeds its MAC queue
+      Ptr<WifiNetDevice> device = wifiDevices[staIndex + 1];
+      Ptr<QueueDisc> queueDisc = fromNode->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (device);
+      uint32_t maxBurst = queueDisc->GetMaxSize ().GetValue ()
+                          + device->GetMac ()->GetTxopQueue (AC_BE)->GetMaxSize ().GetValue ();
+
+      Ptr<SaturationSource> source = CreateObject<SaturationSource> ();
+      source->Setup (sinkSocket, packetSize, tosValue, queueDisc, maxBurst);
+      fromNode->AddApplication (source);
+      sourceApplications.Add (source);
+    }
+  else
+    {
+      OnOffHelper onOffHelper ("ns3::UdpSocketFactory", sinkSocket);
+      onOffHelper.SetConstantRate (offeredLoad, packetSize);
+      onOffHelper.SetAttribute("Tos", UintegerValue(tosValue));
+      onOffHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+
+      ScopedRngRun environmentRun (crnRun);
+      sourceApplications.Add (onOffHelper.Install (fromNode));
+      onOffHelper.AssignStreams (NodeContainer (fromNode), TRAFFIC_STREAM + 2 * staIndex);
+    }
+
+  sourceApplications.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&SourceTx, staIndex));
+
+  // Start time is relative to the installation
+  sourceApplications.Start (Seconds (std::max (0., start - Simulator::Now ().GetSeconds ())));
+}
+
+void
+StationAssociated (uint32_t staIndex, Mac48Address bssid)
+{
+  Simulator::ScheduleNow (&ApplyEdcaOverride, staIndex + 1);
+
+  if (stationAssociated[staIndex])
+    {
+      return;
+    }
+
+  stationAssociated[staIndex] = true;
+  if (++associatedStations == stationAssociated.size ())
+    {
+      associationTime = Simulator::Now ().GetSeconds ();
+      std::cout << "All stations associated after " << associationTime << " s" << std::endl;
+    }
+
+  pendingSources[staIndex] ();
+  pendingSources[staIndex] = nullptr;
+}
+
+void
+StationBeacon (uint32_t staIndex, Time arrival)
+{
+  // Stations without overrides keep the advertised set
+  EdcaOverride &edca = edcaOverrides[staIndex + 1];
+  if (edca.cwMin < 0 && edca.aifsn < 0 && edca.txopLimit < 0)
+    {
+      return;
+    }
+
+  // The EDCA parameter set of the beacon is applied after this trace fires
+  Simulator::ScheduleNow (&ApplyEdcaOverride, staIndex + 1);
+}
+
+void
+ApplyEdcaOverride (uint32_t deviceIndex)
+{
+  EdcaOverride &edca = edcaOverrides[deviceIndex];
+  Ptr<QosTxop> txop = wifiDevices[deviceIndex]->GetMac ()->GetQosTxop (AC_BE);
+
+  // Only the parameters the advertised set changed are written back
+  if (edca.cwMin >= 0 && txop->GetMinCw () != (uint32_t) edca.cwMin)
+    {
+      txop->SetMinCw (edca.cwMin);
+    }
+  if (edca.aifsn >= 0 && txop->GetAifsn () != (uint8_t) edca.aifsn)
+    {
+      txop->SetAifsn (edca.aifsn);
+    }
+  if (edca.txopLimit >= 0 && txop->GetTxopLimit () != MicroSeconds (edca.txopLimit))
+    {
+      txop->SetTxopLimit (MicroSeconds (edca.txopLimit));
+    }
+}
+
+void
+CheckAssociation ()
+{
+  // The agents interact from the fuzz time on, stations still associating then do not send traffic yet
+  if (associatedStations < stationAssociated.size ())
+    {
+      std::cout << "Warning: " << associatedStations << " / " << stationAssociated.size ()
+                << " stations associated at the fuzz time (" << fuzzTime << " s), increase --fuzzTime"
+                << std::endl;
+    }
 }
 
 void
@@ -552,17 +1679,23 @@ PopulateARPcache ()
   Ptr<ArpCache> arp = CreateObject<ArpCache> ();
   arp->SetAliveTimeout (Seconds (3600 * 24 * 365));
 
+  // Single pass: the cache is shared, so it can be attached to an interface
+  // before the remaining entries are added
   for (auto i = NodeList::Begin (); i != NodeList::End (); ++i)
     {
       Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
-      ObjectVectorValue interfaces;
-      ip->GetAttribute ("InterfaceList", interfaces);
 
-      for (auto j = interfaces.Begin (); j != interfaces.End (); j++)
+      for (uint32_t j = 0; j < ip->GetNInterfaces (); j++)
         {
-          Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
+          Ptr<Ipv4Interface> ipIface = ip->GetInterface (j);
           Ptr<NetDevice> device = ipIface->GetDevice ();
+          if (!Mac48Address::IsMatchingType (device->GetAddress ()))
+            {
+              continue;
+            }
+
           Mac48Address addr = Mac48Address::ConvertFrom (device->GetAddress ());
+          ipIface->SetArpCache (arp);
 
           for (uint32_t k = 0; k < ipIface->GetNAddresses (); k++)
             {
@@ -573,35 +1706,33 @@ PopulateARPcache ()
                 }
 
               ArpCache::Entry *entry = arp->Add (ipAddr);
-              Ipv4Header ipv4Hdr;
-              ipv4Hdr.SetDestination (ipAddr);
-
-              Ptr<Packet> p = Create<Packet> (100);
-              entry->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (p, ipv4Hdr));
-              entry->MarkAlive (addr);
+              entry->SetMacAddress (addr);
+              entry->MarkPermanent ();
             }
         }
     }
-
-  for (auto i = NodeList::Begin (); i != NodeList::End (); ++i)
-    {
-      Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
-      ObjectVectorValue interfaces;
-      ip->GetAttribute ("InterfaceList", interfaces);
-
-      for (auto j = interfaces.Begin (); j != interfaces.End (); j++)
-        {
-          Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
-          ipIface->SetAttribute ("ArpCache", PointerValue (arp));
-        }
-    }
 }
 
 void
 ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t nWifi, int cheaterNumber)
 {
-  monitor->CheckForLostPackets ();
-  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  // Timestamps of the interaction phases: start, observation built, published, action received, applied
+  std::chrono::high_resolution_clock::time_point timestamps[5];
+  timestamps[0] = std::chrono::high_resolution_clock::now ();
+
+  if (trackCollisions)
+    {
+      FlushCollisionWindow ();
+    }
+
+  // The running entry of a schedule (normally the last one) ends together with the period
+  if (scheduleLen > 0)
+    {
+      scheduleEvent.Cancel ();
+      CollectScheduleEntry (scheduleEntry, cheaterNumber);
+    }
+
+  std::vector<FlowCounters> stats = appMetrics.GetAll ();
   double nWifiReal = 0;
   double jainsIndexNTemp = 0.;
   double jainsIndexDTemp = 0.;
@@ -616,21 +1747,49 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
   Time currentDelay = Seconds (0);
 
   for(int i = 1; i <= cheaterNumber; i++){
-    throughput_list[i-1] = 8 * ( stats[i].rxBytes - previousStats[i].rxBytes) / (1e6 * interactionTime);
-    lost_list[i-1] = (stats[i].lostPackets - previousStats[i].lostPackets);
-    tx_list[i-1] = ( stats[i].rxBytes - previousStats[i].rxBytes);
+    throughput_list[i-1] = 8 * ((double) stats[i-1].rxBytes - previousStats[i-1].rxBytes) / (1e6 * currentInteractionTime);
+    lost_list[i-1] = ((double) stats[i-1].lostPackets - previousStats[i-1].lostPackets);
+    tx_list[i-1] = ((double) stats[i-1].rxBytes - previousStats[i-1].rxBytes);
     collisions_list[i-1] = global_drop_list[i-1] - previous_global_drop_list[i-1];
-    previous_global_drop_list[i-1] = global_drop_list[i-1];
    }
-  
+
+  // Rolling metrics of all stations, each O(1) per station
+  double stepJainN = 0.;
+  double stepJainD = 0.;
+  for (uint32_t i = 1; i <= nWifi; i++)
+    {
+      const FlowCounters &current = stats[i-1];
+      const FlowCounters &previous = previousStats[i-1];
+      double stepThroughput = 8 * ((double) current.rxBytes - previous.rxBytes) / (1e6 * currentInteractionTime);
+      double stepRx = (double) current.rxPackets - previous.rxPackets;
+      double stepTx = (double) current.txPackets - previous.txPackets;
+      double stepLost = (double) current.lostPackets - previous.lostPackets;
+      double stepCollisions = global_drop_list[i-1] - previous_global_drop_list[i-1];
+
+      rollingThroughput[i-1].Add (stepThroughput);
+      rollingCollisionRatio[i-1].Add (stepCollisions + stepRx > 0 ? stepCollisions / (stepCollisions + stepRx) : 0.);
+      rollingPlr[i-1].Add (stepTx > 0 ? std::min (stepLost / stepTx, 1.) : 0.);
+      ewmaFairness.Update (i - 1, rollingThroughput[i-1].GetEwma ());
+      windowFairness.Update (i - 1, rollingThroughput[i-1].GetWindowMean ());
+
+      stepJainN += stepThroughput;
+      stepJainD += stepThroughput * stepThroughput;
+    }
+  double stepFairness = stepJainD > 0 ? stepJainN * stepJainN / (nWifi * stepJainD) : 1.;
+
+  previous_global_drop_list = global_drop_list;
   previousStats = stats;
 
   bool end_warmup = false;
+  double nextInteractionTime = interactionTime;
 
   if (useMabAgent && Simulator::Now ().GetSeconds () >= fuzzTime)
     {
+      timestamps[1] = std::chrono::high_resolution_clock::now ();
       auto env = m_env->EnvSetterCond ();
-      env->fairness = 0;
+      env->fairness = stepFairness;
+      env->fairness_ewma = ewmaFairness.Get ();
+      env->fairness_window = windowFairness.Get ();
       env->latency = 0;
       env->plr = 0;
       for(int i = 0; i < cheaterNumber; i++){
@@ -638,21 +1797,90 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
         env->tx_list[i] = tx_list[i];
         env->throughput[i] = throughput_list[i];
         env->collisions[i] = collisions_list[i];
+        env->latency_p50[i] = windowLatency[i].GetPercentile (0.5);
+        env->latency_p95[i] = windowLatency[i].GetPercentile (0.95);
+        env->latency_p99[i] = windowLatency[i].GetPercentile (0.99);
+        env->latency_p999[i] = windowLatency[i].GetPercentile (0.999);
+        env->throughput_ewma[i] = rollingThroughput[i].GetEwma ();
+        env->throughput_window[i] = rollingThroughput[i].GetWindowMean ();
+        env->collision_ratio_ewma[i] = rollingCollisionRatio[i].GetEwma ();
+        env->collision_ratio_window[i] = rollingCollisionRatio[i].GetWindowMean ();
+        env->plr_ewma[i] = rollingPlr[i].GetEwma ();
+        env->plr_window[i] = rollingPlr[i].GetWindowMean ();
+        env->qdisc_backlog[i] = queueDiscs.Get (i + 1)->GetNPackets ();
+        env->qdisc_sojourn[i] = queueStats[i].windowQdisc.GetMeanSojourn ();
+        env->qdisc_drops[i] = queueStats[i].windowQdisc.dropped;
+        env->mac_backlog[i] = wifiDevices[i + 1]->GetMac ()->GetTxopQueue (AC_BE)->GetNPackets ();
+        env->mac_sojourn[i] = queueStats[i].windowMac.GetMeanSojourn ();
+        env->mac_drops[i] = queueStats[i].windowMac.dropped;
       }
+      env->schedule_len = scheduleObserved;
+      for (int e = 0; e < scheduleObserved; e++)
+        {
+          for (int i = 0; i < cheaterNumber; i++)
+            {
+              env->schedule_tx[e][i] = scheduleTx[e][i];
+              env->schedule_lost[e][i] = scheduleLost[e][i];
+              env->schedule_throughput[e][i] = scheduleThroughput[e][i];
+              env->schedule_collisions[e][i] = scheduleCollisions[e][i];
+            }
+        }
+      scheduleObserved = 0;
       env->time = Simulator::Now ().GetSeconds () - fuzzTime;
       m_env->SetCompleted ();
+      timestamps[2] = std::chrono::high_resolution_clock::now ();
 
       auto act = m_env->ActionGetterCond ();
+      timestamps[3] = std::chrono::high_resolution_clock::now ();
       end_warmup = act->end_warmup;
+      double actAgentTime = act->agent_time;
+
+      // A schedule replaces the single CW of the agents for the next period
+      scheduleLen = std::min (std::max (act->schedule_len, 0), MAX_SCHEDULE);
+      if (scheduleLen > 0)
+        {
+          nextInteractionTime = 0.;
+          for (int e = 0; e < scheduleLen; e++)
+            {
+              if (act->schedule_duration[e] <= 0.)
+                {
+                  NS_FATAL_ERROR ("Schedule entry " << e << " has non-positive duration " << act->schedule_duration[e]);
+                }
+              scheduleDuration[e] = act->schedule_duration[e];
+              std::copy (act->schedule_cw[e], act->schedule_cw[e] + cheaterNumber, scheduleCw[e]);
+              nextInteractionTime += scheduleDuration[e];
+            }
+        }
+
       m_env->GetCompleted ();
+      if (scheduleLen > 0)
+        {
+          StartScheduleEntry (0, cheaterNumber);
+        }
       for(int i = 1; i <= cheaterNumber; i++){
-        int cw_idx = act->cw[i-1];
-        SetNetworkConfigurationCheater (cw_idx,i);
+        if (actionCw && scheduleLen == 0)
+          {
+            SetNetworkConfigurationCheater (act->cw[i-1], i);
+          }
+        SetEdcaConfigurationCheater (actionAifsn ? act->aifsn[i-1] : -1,
+                                     actionTxop ? act->txop_limit[i-1] : -1,
+                                     actionAmpdu ? act->ampdu_size[i-1] : -1,
+                                     actionRts ? act->rts_threshold[i-1] : -1, i);
       }
+      timestamps[4] = std::chrono::high_resolution_clock::now ();
+      RecordInteraction (timestamps, actAgentTime);
     }
   else if (!useMabAgent && Simulator::Now ().GetSeconds () >= fuzzTime)
     {
       end_warmup = true;
+      if (behaviourPolicy != "none")
+        {
+          ApplyBehaviourPolicy (cheaterNumber, throughput_list, tx_list, lost_list, collisions_list);
+        }
+      else if (frozenPolicy.IsLoaded ())
+        {
+          ApplyFrozenPolicy (cheaterNumber);
+        }
     }
 
   // End warmup period, define simulation stop time, and reset stats
@@ -668,10 +1896,21 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
   // csvLogOutput << agentName << "," << dataRate << "," << distance << "," << nWifi << "," << nWifiReal << "," << RngSeedManager::GetRun () << "," << end_warmup << ","
   // << fairnessIndex << "," << latencyPerPacket << "," << PLR << "," << throughput << "," << Simulator::Now().GetSeconds() - fuzzTime << std::endl;
 
+  for (auto &histogram : windowLatency)
+    {
+      histogram.Reset ();
+    }
+  for (auto &station : queueStats)
+    {
+      station.windowQdisc.Reset ();
+      station.windowMac.Reset ();
+    }
+
   delete throughput_list;
   delete tx_list;
   delete lost_list;
-  Simulator::Schedule (Seconds(interactionTime), &ExecuteAction, agentName, dataRate, distance, nWifi, cheaterNumber);
+  currentInteractionTime = nextInteractionTime;
+  Simulator::Schedule (Seconds(currentInteractionTime), &ExecuteAction, agentName, dataRate, distance, nWifi, cheaterNumber);
   // for (uint32_t j = 0; j < nWifi; ++j)
   // {
   //   Config::Connect ("/NodeList/"+ std::to_string(j) +"/DeviceList/*/$ns3::WifiNetDevice/Mac/MpduResponseTimeout", MakeCallback(&TxDrop));
@@ -679,18 +1918,232 @@ ExecuteAction (std::string agentName, double dataRate, double distance, uint32_t
   
 }
 
+void
+StartScheduleEntry (int entry, int cheaterNumber)
+{
+  scheduleEntry = entry;
+  scheduleStats = appMetrics.GetAll ();
+  scheduleDrops = global_drop_list;
+
+  for (int i = 1; i <= cheaterNumber; i++)
+    {
+      SetNetworkConfigurationCheater (scheduleCw[entry][i-1], i);
+    }
+
+  // The last entry is collected by ExecuteAction at the end of the period
+  if (entry + 1 < scheduleLen)
+    {
+      scheduleEvent = Simulator::Schedule (Seconds (scheduleDuration[entry]), &NextScheduleEntry, entry, cheaterNumber);
+    }
+}
+
+void
+CollectScheduleEntry (int entry, int cheaterNumber)
+{
+  const std::vector<FlowCounters> &stats = appMetrics.GetAll ();
+
+  for (int i = 1; i <= cheaterNumber; i++)
+    {
+      double rxBytes = (double) stats[i-1].rxBytes - scheduleStats[i-1].rxBytes;
+      scheduleTx[entry][i-1] = rxBytes;
+      scheduleLost[entry][i-1] = (double) stats[i-1].lostPackets - scheduleStats[i-1].lostPackets;
+      scheduleThroughput[entry][i-1] = 8 * rxBytes / (1e6 * scheduleDuration[entry]);
+      scheduleCollisions[entry][i-1] = global_drop_list[i-1] - scheduleDrops[i-1];
+    }
+  scheduleObserved = entry + 1;
+}
+
+void
+NextScheduleEntry (int entry, int cheaterNumber)
+{
+  CollectScheduleEntry (entry, cheaterNumber);
+  StartScheduleEntry (entry + 1, cheaterNumber);
+}
+
 void
 SetNetworkConfigurationCheater (int cw_idx, int cheaterNum)
 {
   if (cw_idx >= 0)
     {
       // Set CW
-      AttributeContainerValue<UintegerValue> cwValue { std::vector {UintegerValue (pow (2, cw_idx))} };
-      Config::Set ("/NodeList/" + std::to_string(cheaterNum) + "/DeviceList/*/$ns3::WifiNetDevice/Mac/BE_Txop/MinCws", cwValue);
-      // Config::Set ("/NodeList/" + std::to_string(cheaterNum) + "/DeviceList/*/$ns3::WifiNetDevice/Mac/BE_Txop/MaxCws", cwValue);
+      Ptr<QosTxop> txop = wifiDevices[cheaterNum]->GetMac ()->GetQosTxop (AC_BE);
+      txop->SetMinCw (pow (2, cw_idx));
+      // txop->SetMaxCw (pow (2, cw_idx));
+      edcaOverrides[cheaterNum].cwMin = pow (2, cw_idx);
+
+      MarkMisbehaviour (cheaterNum - 1, pow (2, cw_idx) < advertisedCwMin);
+    }
+}
+
+void
+DetectorPhyState (Time start, Time duration, WifiPhyState state)
+{
+  // Idle and CCA busy periods are logged when they end, so every idle period
+  // preceding a reception is accounted for before the frame reaches the sniffer
+  if (state != WifiPhyState::IDLE || duration <= detectorAifs)
+    {
+      return;
+    }
+
+  totalIdleSlots += std::floor ((duration - detectorAifs).GetSeconds () / detectorSlot.GetSeconds ());
+}
+
+void
+DetectorSnifferRx (Ptr<const Packet> packet, uint16_t channelFreqMhz, WifiTxVector txVector,
+                   MpduInfo aMpdu, SignalNoiseDbm signalNoise, uint16_t staId)
+{
+  // Only the first MPDU of a PPDU marks the end of a backoff
+  if (aMpdu.type != NORMAL_MPDU && aMpdu.type != SINGLE_MPDU && aMpdu.type != FIRST_MPDU_IN_AGGREGATE)
+    {
+      return;
+    }
+
+  // Frame control, duration, Addr1 and Addr2 (16 B) are copied to the stack, past the
+  // subframe header of an A-MPDU, so that nothing is allocated per frame
+  static const uint32_t subframeHeaderSize = AmpduSubframeHeader ().GetSerializedSize ();
+  uint8_t bytes[32];
+  uint32_t size = (aMpdu.type == NORMAL_MPDU ? 0 : subframeHeaderSize) + 16;
+  if (size > sizeof (bytes) || packet->CopyData (bytes, size) < size)
+    {
+      return;
+    }
+  const uint8_t *macHeader = bytes + size - 16;
+
+  // QoS data: type 2 with the QoS bit of the subtype, Retry is bit 3 of the flags
+  if ((macHeader[0] & 0x0c) != 0x08 || (macHeader[0] & 0x80) == 0)
+    {
+      return;
+    }
+  bool retry = macHeader[1] & 0x08;
+
+  auto station = stationByAddress.find (BytesToKey (macHeader + 10));
+  if (station == stationByAddress.end ())
+    {
+      return;
+    }
+
+  BackoffEstimate &est = backoffEstimates[station->second];
+  double backoff = totalIdleSlots - est.idleSlotsAtLastTx;
+  bool firstFrame = !est.seen;
+  est.idleSlotsAtLastTx = totalIdleSlots;
+  est.seen = true;
+
+  // Retransmissions are drawn from a doubled CW, so they do not describe CWmin
+  if (firstFrame || retry)
+    {
+      return;
+    }
+
+  if (est.samples == 0)
+    {
+      est.meanBackoff = backoff;
+    }
+  double delta = backoff - est.meanBackoff;
+  est.meanBackoff += detectorAlpha * delta;
+  est.varBackoff = (1 - detectorAlpha) * (est.varBackoff + detectorAlpha * delta * delta);
+  est.histogram[std::min (15, (int) std::log2 (backoff + 1))]++;
+  est.samples++;
+
+  // Backoff is uniform in [0, CW], so the mean estimates CW / 2
+  if (est.flagTime < 0 && est.samples >= detectorMinSamples
+      && 2 * est.meanBackoff < detectorThreshold * advertisedCwMin)
+    {
+      double now = Simulator::Now ().GetSeconds ();
+      est.flagTime = now;
+      if (est.misbehaviourStart >= 0)
+        {
+          est.timeToDetect = now - est.misbehaviourStart;
+        }
+      else
+        {
+          est.falsePositive = true;
+        }
+      NS_LOG_INFO ("Detector: station " << station->second << " flagged at " << now << " s (estimated CW "
+                   << 2 * est.meanBackoff << ")");
+    }
+}
+
+void
+MarkMisbehaviour (uint32_t staIndex, bool misbehaving)
+{
+  if (!useDetector)
+    {
+      return;
+    }
+
+  BackoffEstimate &est = backoffEstimates[staIndex];
+  if (misbehaving && est.misbehaviourStart < 0)
+    {
+      est.misbehaviourStart = Simulator::Now ().GetSeconds ();
+    }
+  else if (!misbehaving && est.flagTime < 0)
+    {
+      est.misbehaviourStart = -1.;
+    }
+}
+
+void
+SetEdcaConfigurationCheater (int aifsn, int txopLimit, int ampduSize, int rtsThreshold, int cheaterNum)
+{
+  Ptr<WifiNetDevice> device = wifiDevices[cheaterNum];
+  Ptr<QosTxop> txop = device->GetMac ()->GetQosTxop (AC_BE);
+
+  if (aifsn >= 0)
+    {
+      txop->SetAifsn (aifsn);
+      edcaOverrides[cheaterNum].aifsn = aifsn;
+    }
+  if (txopLimit >= 0)
+    {
+      txop->SetTxopLimit (MicroSeconds (txopLimit));
+      edcaOverrides[cheaterNum].txopLimit = txopLimit;
+    }
+  if (ampduSize >= 0)
+    {
+      device->GetMac ()->SetAttribute ("BE_MaxAmpduSize", UintegerValue (ampduSize));
+    }
+  if (rtsThreshold >= 0)
+    {
+      device->GetRemoteStationManager ()->SetAttribute ("RtsCtsThreshold", UintegerValue (rtsThreshold));
     }
 }
 
+void
+ParseActionDims (std::string actionDims)
+{
+  std::string dims[16];
+  int n = 0;
+  splitString (actionDims, ',', dims, n);
+
+  actionCw = actionAifsn = actionTxop = actionAmpdu = actionRts = false;
+  for (int i = 0; i < n; i++)
+    {
+      if (dims[i] == "cw")
+        {
+          actionCw = true;
+        }
+      else if (dims[i] == "aifsn")
+        {
+          actionAifsn = true;
+        }
+      else if (dims[i] == "txop")
+        {
+          actionTxop = true;
+        }
+      else if (dims[i] == "ampdu")
+        {
+          actionAmpdu = true;
+        }
+      else if (dims[i] == "rts")
+        {
+          actionRts = true;
+        }
+      else
+        {
+          NS_FATAL_ERROR ("Unknown action dimension: " << dims[i]);
+        }
+    }
+}
 
 void
 SetNetworkConfiguration (int cw_idx)
@@ -698,9 +2151,327 @@ SetNetworkConfiguration (int cw_idx)
   if (cw_idx >= 0)
     {
       // Set CW
-      AttributeContainerValue<UintegerValue> cwValueMIN { std::vector {UintegerValue (32)} };
-      AttributeContainerValue<UintegerValue> cwValueMAX { std::vector {UintegerValue (1024)} };
-      Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/BE_Txop/MinCws", cwValueMIN);
-      Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/BE_Txop/MaxCws", cwValueMAX);
+      for (auto &device : wifiDevices)
+        {
+          Ptr<QosTxop> txop = device->GetMac ()->GetQosTxop (AC_BE);
+          txop->SetMinCw (32);
+          txop->SetMaxCw (1024);
+        }
+    }
+}
+
+void
+ApplyFrozenPolicy (int cheaterNumber)
+{
+  for (int i = 1; i <= cheaterNumber; i++)
+    {
+      const FrozenAction &action = frozenPolicy.Get (i - 1);
+      SetNetworkConfigurationCheater (action.cw, i);
+      SetEdcaConfigurationCheater (action.aifsn, action.txopLimit, action.ampduSize, action.rtsThreshold, i);
+    }
+}
+
+void
+ApplyBehaviourPolicy (int cheaterNumber, double *throughput_list, double *tx_list,
+                      double *lost_list, double *collisions_list)
+{
+  float time = Simulator::Now ().GetSeconds () - fuzzTime;
+
+  for (int i = 0; i < cheaterNumber; i++)
+    {
+      float obs[OBS_SIZE];
+      obs[OBS_THROUGHPUT] = throughput_list[i];
+      obs[OBS_RX_BYTES] = tx_list[i];
+      obs[OBS_LOST] = lost_list[i];
+      obs[OBS_COLLISIONS] = collisions_list[i];
+      obs[OBS_LATENCY_P50] = windowLatency[i].GetPercentile (0.5);
+      obs[OBS_LATENCY_P95] = windowLatency[i].GetPercentile (0.95);
+      obs[OBS_LATENCY_P99] = windowLatency[i].GetPercentile (0.99);
+      obs[OBS_LATENCY_P999] = windowLatency[i].GetPercentile (0.999);
+
+      // The observation of this window completes the transition of the previous action
+      TransitionRecord &record = pendingTransitions[i];
+      if (policyStep > 0)
+        {
+          std::copy (obs, obs + OBS_SIZE, record.nextObs);
+          datasetWriter.Write (record);
+        }
+
+      uint32_t arm = policyDefaultArm;
+      if (behaviourPolicy == "random")
+        {
+          arm = policyRng->GetInteger (0, policyArms - 1);
+        }
+      else if (behaviourPolicy == "epsilon" && policyRng->GetValue () < policyEpsilon)
+        {
+          int low = std::max (0, (int) policyDefaultArm - (int) policySpread);
+          int high = std::min ((int) policyArms - 1, (int) (policyDefaultArm + policySpread));
+          arm = policyRng->GetInteger (low, high);
+        }
+      else if (behaviourPolicy == "sweep")
+        {
+          // Agents start the sweep at different arms, so that every window mixes several CWs
+          arm = (policyStep / policySweepHold + i) % policyArms;
+        }
+
+      record.run = RngSeedManager::GetRun ();
+      record.step = policyStep;
+      record.agent = i;
+      record.action = arm;
+      record.time = time;
+      std::copy (obs, obs + OBS_SIZE, record.obs);
+
+      SetNetworkConfigurationCheater (arm, i + 1);
+    }
+
+  policyStep++;
+}
+
+void
+CollisionTxBegin (uint32_t deviceIndex, Ptr<const Packet> packet, double txPowerW)
+{
+  // The trace fires for every MPDU of a PPDU
+  if (std::find (activeTransmitters.begin (), activeTransmitters.end (), deviceIndex) != activeTransmitters.end ())
+    {
+      return;
+    }
+
+  frameOverlaps[deviceIndex] = activeTransmitters;
+  frameAttributed[deviceIndex] = false;
+  for (uint32_t other : activeTransmitters)
+    {
+      frameOverlaps[other].push_back (deviceIndex);
+    }
+  activeTransmitters.push_back (deviceIndex);
+}
+
+void
+CollisionTxEnd (uint32_t deviceIndex, Ptr<const Packet> packet)
+{
+  auto it = std::find (activeTransmitters.begin (), activeTransmitters.end (), deviceIndex);
+  if (it != activeTransmitters.end ())
+    {
+      *it = activeTransmitters.back ();
+      activeTransmitters.pop_back ();
+    }
+}
+
+void
+CollisionRxDrop (Ptr<const Packet> packet, WifiPhyRxfailureReason reason)
+{
+  // Only the drops another transmission can cause, not e.g. the frames arriving while the AP transmits
+  switch (reason)
+    {
+    case RXING:
+    case BUSY_DECODING_PREAMBLE:
+    case PREAMBLE_DETECT_FAILURE:
+    case PREAMBLE_DETECTION_PACKET_SWITCH:
+    case FRAME_CAPTURE_PACKET_SWITCH:
+    case L_SIG_FAILURE:
+    case HT_SIG_FAILURE:
+    case SIG_A_FAILURE:
+    case SIG_B_FAILURE:
+    case U_SIG_FAILURE:
+      AttributeCollision (packet);
+      break;
+    default:
+      break;
+    }
+}
+
+// The payload of the frame the AP locked onto failed, in a same-slot collision the usual outcome
+void
+CollisionRxError (Ptr<const Packet> packet, double snr)
+{
+  AttributeCollision (packet);
+}
+
+void
+AttributeCollision (Ptr<const Packet> packet)
+{
+  // The packet is an MPDU or a whole A-MPDU, whose first MPDU follows a subframe header. The
+  // transmitter address is read from the stack copy at either offset and only a known device
+  // matches. Control responses carry no transmitter address and are not attributed.
+  static const uint32_t subframeHeaderSize = AmpduSubframeHeader ().GetSerializedSize ();
+  uint8_t bytes[32];
+  uint32_t size = std::min<uint32_t> (packet->GetSize (), subframeHeaderSize + 16);
+  if (size < 16 || size > sizeof (bytes))
+    {
+      return;
+    }
+  packet->CopyData (bytes, size);
+
+  auto device = deviceByAddress.find (BytesToKey (bytes + 10));
+  if (device == deviceByAddress.end () && size == subframeHeaderSize + 16)
+    {
+      device = deviceByAddress.find (BytesToKey (bytes + subframeHeaderSize + 10));
+    }
+  if (device == deviceByAddress.end ())
+    {
+      return;
+    }
+
+  uint32_t victim = device->second;
+  std::vector<uint32_t> &overlaps = frameOverlaps[victim];
+  if (frameAttributed[victim] || overlaps.empty ())
+    {
+      return;
+    }
+  frameAttributed[victim] = true;
+
+  for (uint32_t interferer : overlaps)
+    {
+      uint32_t cell = victim * nDevices + interferer;
+      collisionMatrix[cell]++;
+      if (windowCollisionMatrix[cell]++ == 0)
+        {
+          windowCollisionCells.push_back (cell);
+        }
+    }
+}
+
+void
+FlushCollisionWindow ()
+{
+  double time = Simulator::Now ().GetSeconds () - fuzzTime;
+  for (uint32_t cell : windowCollisionCells)
+    {
+      if (collisionWindowFile.is_open ())
+        {
+          collisionWindowFile << time << "," << cell / nDevices << "," << cell % nDevices << ","
+                              << windowCollisionMatrix[cell] << std::endl;
+        }
+      windowCollisionMatrix[cell] = 0;
+    }
+  windowCollisionCells.clear ();
+}
+
+void
+PublishTelemetry (uint32_t nWifi)
+{
+  auto wallNow = std::chrono::steady_clock::now ();
+  double wall = std::chrono::duration<double> (wallNow - telemetryWallTime).count ();
+  double simNow = Simulator::Now ().GetSeconds ();
+  double simElapsed = simNow - telemetrySimTime;
+  uint64_t events = Simulator::GetEventCount ();
+
+  std::ostringstream json;
+  json << "{\"time\":" << simNow
+       << ",\"phase\":\"" << (simulationPhase ? "simulation" : simNow < fuzzTime ? "fuzz" : "warmup") << "\""
+       << ",\"simRate\":" << (wall > 0 ? simElapsed / wall : 0.)
+       << ",\"eventsPerSecond\":" << (wall > 0 ? (events - telemetryEvents) / wall : 0.)
+       << ",\"events\":" << events
+       << ",\"interactionStep\":" << interactionStep
+       << ",\"rss\":" << GetCurrentRss ()
+       << ",\"stations\":[";
+
+  // The counters restart at the warmup end, a decrease means a reset
+  const std::vector<FlowCounters> &stats = appMetrics.GetAll ();
+  for (uint32_t i = 0; i < nWifi; i++)
+    {
+      double rxBytes = stats[i].rxBytes;
+      double delta = rxBytes >= telemetryRxBytes[i] ? rxBytes - telemetryRxBytes[i] : rxBytes;
+      telemetryRxBytes[i] = rxBytes;
+
+      Ptr<QosTxop> txop = wifiDevices[i+1]->GetMac ()->GetQosTxop (AC_BE);
+      json << (i > 0 ? "," : "") << "{\"throughput\":" << (simElapsed > 0 ? 8 * delta / (1e6 * simElapsed) : 0.)
+           << ",\"collisions\":" << global_drop_list[i]
+           << ",\"cwMin\":" << txop->GetMinCw ()
+           << ",\"aifsn\":" << (uint32_t) txop->GetAifsn ()
+           << ",\"txopLimit\":" << txop->GetTxopLimit ().GetMicroSeconds ()
+           << ",\"qdiscBacklog\":" << queueDiscs.Get (i+1)->GetNPackets ()
+           << ",\"macBacklog\":" << wifiDevices[i+1]->GetMac ()->GetTxopQueue (AC_BE)->GetNPackets () << "}";
+    }
+  json << "]}";
+
+  telemetry.GetBackBuffer () = json.str ();
+  telemetry.Publish ();
+
+  telemetryWallTime = wallNow;
+  telemetrySimTime = simNow;
+  telemetryEvents = events;
+  Simulator::Schedule (Seconds (telemetryInterval), &PublishTelemetry, nWifi);
+}
+
+void
+MonitorMemory (std::string csvLogPath)
+{
+  uint32_t qdiscPackets = 0;
+  for (auto qdisc = queueDiscs.Begin (); qdisc != queueDiscs.End (); ++qdisc)
+    {
+      qdiscPackets += (*qdisc)->GetNPackets ();
+    }
+
+  uint32_t macQueuePackets = 0;
+  for (auto &device : wifiDevices)
+    {
+      macQueuePackets += device->GetMac ()->GetTxopQueue (AC_BE)->GetNPackets ();
+    }
+
+  peakQdiscPackets = std::max (peakQdiscPackets, (int64_t) qdiscPackets);
+  peakMacQueuePackets = std::max (peakMacQueuePackets, (int64_t) macQueuePackets);
+
+  if (memoryBudget > 0 && !memoryBounded && GetCurrentRss () > MEMORY_BUDGET_MARGIN * memoryBudget)
+    {
+      BoundMemoryUse (csvLogPath);
+    }
+
+  if (eventRing.IsOpen ())
+    {
+      eventRing.PruneConsumers ();
+    }
+
+  // Keep the streamed log out of memory
+  if (csvLogFile.is_open ())
+    {
+      csvLogFile << csvLogOutput.str ();
+      csvLogOutput.str ("");
+    }
+
+  Simulator::Schedule (Seconds (memoryInterval), &MonitorMemory, csvLogPath);
+}
+
+void
+BoundMemoryUse (std::string csvLogPath)
+{
+  memoryBounded = true;
+  memoryBoundTime = Simulator::Now ().GetSeconds ();
+  std::cout << "Memory usage " << GetCurrentRss () << " MB close to the budget, bounding the collectors at "
+            << memoryBoundTime << " s" << std::endl;
+
+  // Stream the CSV log to the file from now on
+  csvLogFile.open (csvLogPath);
+
+  // Stop tracking new packets in FlowMonitor and release the ones already lost (the XML covers the flows
+  // until now, the metrics come from the applications). The simulated queues are left untouched.
+  if (monitor)
+    {
+      monitor->StopRightNow ();
+      monitor->CheckForLostPackets ();
+    }
+}
+
+void
+RecordInteraction (std::chrono::high_resolution_clock::time_point timestamps[5], double actAgentTime)
+{
+  auto phase = [&] (int from, int to) {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds> (timestamps[to] - timestamps[from]).count ();
+  };
+
+  uint64_t agentNs = (uint64_t) std::max (0., actAgentTime * 1e9);
+
+  buildTime.Record (phase (0, 1));
+  publishTime.Record (phase (1, 2));
+  waitTime.Record (phase (2, 3));
+  agentTime.Record (agentNs);
+  applyTime.Record (phase (3, 4));
+  handshakeTime.Record (phase (1, 3));
+  interactionStep++;
+
+  if (interactionTraceFile.is_open ())
+    {
+      interactionTraceFile << interactionStep << "," << Simulator::Now ().GetSeconds () << ","
+                           << phase (0, 1) * 1e-9 << "," << phase (1, 2) * 1e-9 << "," << phase (2, 3) * 1e-9 << ","
+                           << actAgentTime << "," << phase (3, 4) * 1e-9 << std::endl;
     }
 }
@@ -0,0 +1,750 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/ns3-ai-module.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/qos-txop.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/yans-wifi-helper.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include <mpi.h>
+#endif
+
+#include "latency-histogram.h"
+#include "ns3-ai-structures.h"
+#include "random-streams.h"
+
+/*
+ * Deployment of many BSSs on non-overlapping channels, partitioned across the ranks of
+ * the ns-3 distributed simulator.
+ *
+ * BSS b (an AP with nWifi ad hoc stations sending uplink traffic, as in
+ * scenario_mgr_multi_agent) runs on rank b % ranks. Every AP is linked to a core node
+ * on rank 0 by a point-to-point backhaul, whose delay is the lookahead of the
+ * partitions. At every interaction, the per-station counters of all ranks are summed at
+ * rank 0, which exchanges them with the agents and broadcasts their actions back.
+ *
+ * Run it with a local mpirun, e.g. mpirun -np 4 <binary> --nBss=8. Without MPI
+ * (ns-3 configured without --enable-mpi) all BSSs run in a single process.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("scenario");
+
+// Exchanges with the agents happen at rank 0 only
+Ns3AIRL<sEnv, sAct> *m_env = nullptr;
+
+/***** Per-station counters *****/
+
+// Counters of station i (0-based) of BSS b are at (b * nWifi + i) * N_STATION_FIELDS
+enum StationField
+{
+  RX_BYTES,
+  RX_PACKETS,
+  TX_PACKETS,
+  DELAY_SUM,      // s
+  RETRIES,        // retransmitted MPDUs
+  N_STATION_FIELDS
+};
+
+/***** Functions declarations *****/
+
+void ExecuteAction (std::string agentName, double dataRate);
+void SetNetworkConfigurationCheater (int cw_idx, uint32_t bss, uint32_t station);
+void InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_t sinkInterface,
+                              uint32_t port, DataRate offeredLoad, uint32_t packetSize, uint32_t stationIndex);
+void SinkRx (uint32_t stationIndex, Ptr<const Packet> packet, const Address &from,
+             const Address &to, const SeqTsSizeHeader &header);
+void SourceTx (uint32_t stationIndex, Ptr<const Packet> packet);
+void MonitorRetransmissions (uint32_t stationIndex, Ptr<const Packet> packet);
+void ReduceToRoot (std::vector<double> &values);
+void BroadcastFromRoot (std::vector<double> &values);
+void WriteBssMetrics (std::ostream &output, const std::vector<double> &counters, double duration,
+                      std::string prefix);
+
+/***** Global variables and constants *****/
+
+// 20 MHz channels of the 5 GHz band, assigned to the BSSs in turn
+const uint16_t CHANNELS[] = {36, 40, 44, 48, 52, 56, 60, 64, 100, 104, 108, 112, 116, 120,
+                             124, 128, 132, 136, 140, 144, 149, 153, 157, 161, 165};
+const uint32_t N_CHANNELS = sizeof (CHANNELS) / sizeof (CHANNELS[0]);
+
+uint32_t rank = 0;
+uint32_t ranks = 1;
+#ifdef NS3_MPI
+MPI_Comm bssComm;   // the collectives of the scenario, apart from the synchronization of the simulator
+#endif
+
+uint32_t nBss = 4;
+uint32_t nWifi = 10;
+int cheaterNumber = 1;
+double fuzzTime = 5.;
+double simulationTime = 5.;
+double interactionTime = 0.5;
+double warmupEndTime = 0.;
+bool simulationPhase = false;
+bool useMabAgent = false;
+int64_t crnRun = -1;
+
+// Wi-Fi devices of each BSS (0 - AP, 1..nWifi - stations)
+std::vector<std::vector<Ptr<WifiNetDevice>>> bssDevices;
+
+// Counters of the stations of the local BSSs, since the last interaction and since the warmup end
+std::vector<double> windowCounters;
+std::vector<double> totalCounters;
+
+// Per-packet latency of the station of each agent since the last interaction, summed at rank 0
+std::vector<LatencyHistogram> agentLatency;
+
+std::ostringstream csvLogOutput;
+
+uint32_t
+GetBssRank (uint32_t bss)
+{
+  return bss % ranks;
+}
+
+/***** Main with scenario definition *****/
+
+int
+main (int argc, char *argv[])
+{
+  // Initialize default simulation parameters
+  uint32_t packetSize = 1500;
+  uint32_t dataRate = 110;
+  uint32_t maxQueueSize = 100;
+  double distance = 10.;
+  double bssSpacing = 100.;
+  double backhaulDelay = 0.001;
+  std::string backhaulRate = "10Gbps";
+  bool sinkAtCore = false;
+
+  std::string agentName = "wifi";
+  std::string csvPath = "results.csv";
+  std::string csvLogPath = "logs.csv";
+  std::string bssCsvPath = "bss.csv";
+  std::string actionDims = "cw";
+
+  int cw_idx = -1;
+  bool rts_cts = false;
+  bool ampdu = true;
+
+  // Parse command line arguments
+  CommandLine cmd;
+  cmd.AddValue ("actionDims", "Action dimensions controlled by the agents (only cw)", actionDims);
+  cmd.AddValue ("agentName", "Name of the agent", agentName);
+  cmd.AddValue ("ampdu", "Enable A-MPDU aggregation", ampdu);
+  cmd.AddValue ("backhaulDelay", "Delay of the backhaul links, the lookahead of the partitions (s)", backhaulDelay);
+  cmd.AddValue ("backhaulRate", "Data rate of the backhaul links", backhaulRate);
+  cmd.AddValue ("bssCsvPath", "Path to output CSV file with the per-BSS results", bssCsvPath);
+  cmd.AddValue ("bssSpacing", "Distance between the APs of neighbouring BSSs (m)", bssSpacing);
+  cmd.AddValue ("crnRun", "Common random numbers: draw the environment streams from this run instead of RngRun (-1 - disabled)", crnRun);
+  cmd.AddValue ("csvLogPath", "Path to output CSV log file", csvLogPath);
+  cmd.AddValue ("csvPath", "Path to output CSV file", csvPath);
+  cmd.AddValue ("cw", "Contention window (const CW = 2 ^ (4 + x) if x >= 0) (only for wifi agent)", cw_idx);
+  cmd.AddValue ("dataRate", "Traffic generator data rate (Mb/s)", dataRate);
+  cmd.AddValue ("distance", "Max distance between AP and STAs (m)", distance);
+  cmd.AddValue ("fuzzTime", "Maximum fuzz value (s)", fuzzTime);
+  cmd.AddValue ("interactionTime", "Time between agent actions (s)", interactionTime);
+  cmd.AddValue ("maxQueueSize", "Max queue size (packets)", maxQueueSize);
+  cmd.AddValue ("nBss", "Number of BSSs", nBss);
+  cmd.AddValue ("nWifi", "Number of stations in each BSS", nWifi);
+  cmd.AddValue ("packetSize", "Packets size (B)", packetSize);
+  cmd.AddValue ("rtsCts", "Enable RTS/CTS", rts_cts);
+  cmd.AddValue ("simulationTime", "Duration of simulation (s)", simulationTime);
+  cmd.AddValue ("sinkAtCore", "Send the traffic of the stations over the backhaul to a sink at the core node", sinkAtCore);
+  cmd.AddValue ("cheaterNumber", "Number of cheaters in each BSS", cheaterNumber);
+  cmd.Parse (argc, argv);
+
+#ifdef NS3_MPI
+  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::DistributedSimulatorImpl"));
+  MpiInterface::Enable (&argc, &argv);
+  rank = MpiInterface::GetSystemId ();
+  ranks = MpiInterface::GetSize ();
+  MPI_Comm_dup (MPI_COMM_WORLD, &bssComm);
+#endif
+
+  if (actionDims != "cw")
+    {
+      NS_FATAL_ERROR ("The agents control only the CW in the multi-BSS scenario, not " << actionDims);
+    }
+  if (backhaulDelay <= 0)
+    {
+      NS_FATAL_ERROR ("The backhaul delay must be positive, it is the lookahead of the partitions");
+    }
+  if (nWifi > 253 || nBss > 250)
+    {
+      NS_FATAL_ERROR ("At most 250 BSSs of 253 stations are addressable");
+    }
+  if (nBss < ranks)
+    {
+      NS_FATAL_ERROR ("Fewer BSSs (" << nBss << ") than ranks (" << ranks << ")");
+    }
+
+  useMabAgent = agentName != "wifi";
+  if (useMabAgent && nBss * cheaterNumber > MAX_AGENTS)
+    {
+      NS_FATAL_ERROR ("At most " << MAX_AGENTS << " agents in all BSSs, got " << nBss * cheaterNumber);
+    }
+  if (cheaterNumber < 0 || cheaterNumber > (int) nWifi)
+    {
+      NS_FATAL_ERROR ("The number of cheaters (" << cheaterNumber << ") must be between 0 and nWifi (" << nWifi << ")");
+    }
+  CheckStreamLayout ((uint64_t) nBss * nWifi, (uint64_t) nBss * (nWifi + 1));
+
+  // Print simulation settings to screen
+  if (rank == 0)
+    {
+      std::cout << std::endl
+                << "Simulating " << nBss << " IEEE 802.11ax BSSs on " << ranks << " ranks with the following settings:" << std::endl
+                << "- agent: " << agentName << std::endl
+                << "- frequency band: 5 GHz, 20 MHz channels" << std::endl
+                << "- max data rate: " << dataRate << " Mb/s" << std::endl
+                << "- packets size: " << packetSize << " B" << std::endl
+                << "- max queue size: " << maxQueueSize << " packets" << std::endl
+                << "- number of stations: " << nWifi << " per BSS" << std::endl
+                << "- max distance between AP and STAs: " << distance << " m" << std::endl
+                << "- simulation time: " << simulationTime << " s" << std::endl
+                << "- max fuzz time: " << fuzzTime << " s" << std::endl
+                << "- interaction time: " << interactionTime << " s" << std::endl
+                << "- backhaul: " << backhaulRate << ", " << backhaulDelay * 1e3 << " ms"
+                << (sinkAtCore ? " (carries the traffic)" : "") << std::endl
+                << "- RTS/CTS: " << (rts_cts ? "enabled" : "disabled") << std::endl
+                << "- A-MPDU: " << (ampdu ? "enabled" : "disabled") << std::endl;
+
+      m_env = new Ns3AIRL<sEnv, sAct> (DEFAULT_MEMBLOCK_KEY);
+    }
+
+  Config::SetDefault ("ns3::WifiMacQueue::MaxSize", StringValue (std::to_string (maxQueueSize) + "p"));
+
+  // Nodes of every BSS exist on all ranks, only the devices of the local BSSs run
+  NodeContainer coreNode;
+  coreNode.Create (1, 0);
+
+  std::vector<NodeContainer> apNodes (nBss);
+  std::vector<NodeContainer> staNodes (nBss);
+  bssDevices.resize (nBss);
+
+  InternetStackHelper stack;
+  stack.Install (coreNode);
+
+  PointToPointHelper backhaul;
+  backhaul.SetDeviceAttribute ("DataRate", StringValue (backhaulRate));
+  backhaul.SetChannelAttribute ("Delay", TimeValue (Seconds (backhaulDelay)));
+
+  Ipv4AddressHelper wifiAddress;
+  Ipv4AddressHelper backhaulAddress ("172.16.0.0", "255.255.255.252");
+
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_STANDARD_80211ax);
+  wifi.SetRemoteStationManager ("ns3::IdealWifiManager", "RtsCtsThreshold", UintegerValue (rts_cts ? 0 : 65535));
+
+  WifiMacHelper mac;
+  mac.SetType ("ns3::AdhocWifiMac");
+
+  uint32_t gridSize = std::ceil (std::sqrt (nBss));
+
+  for (uint32_t b = 0; b < nBss; b++)
+    {
+      apNodes[b].Create (1, GetBssRank (b));
+      staNodes[b].Create (nWifi, GetBssRank (b));
+
+      // APs on a square grid, stations around their AP
+      double apX = (b % gridSize) * bssSpacing;
+      double apY = (b / gridSize) * bssSpacing;
+
+      MobilityHelper mobility;
+      Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+      positionAllocator->SetX (apX);
+      positionAllocator->SetY (apY);
+      positionAllocator->SetRho (distance);
+      {
+        ScopedRngRun environmentRun (crnRun);
+        positionAllocator->AssignStreams (BSS_STREAM + b * BSS_STREAM_BLOCK);
+      }
+      mobility.SetPositionAllocator (positionAllocator);
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+      mobility.Install (apNodes[b]);
+      mobility.Install (staNodes[b]);
+      apNodes[b].Get (0)->GetObject<MobilityModel> ()->SetPosition (Vector (apX, apY, 0.0));
+
+      // Every BSS has its own channel object, the channels do not overlap
+      YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
+      Ptr<YansWifiChannel> channel = channelHelper.Create ();
+      {
+        ScopedRngRun environmentRun (crnRun);
+        channelHelper.AssignStreams (channel, BSS_STREAM + b * BSS_STREAM_BLOCK + 1);
+      }
+
+      YansWifiPhyHelper phy;
+      phy.SetChannel (channel);
+      phy.Set ("ChannelSettings", StringValue ("{" + std::to_string (CHANNELS[b % N_CHANNELS]) + ", 20, BAND_5GHZ, 0}"));
+
+      NetDeviceContainer apDevice = wifi.Install (phy, mac, apNodes[b]);
+      NetDeviceContainer staDevice = wifi.Install (phy, mac, staNodes[b]);
+
+      bssDevices[b].push_back (DynamicCast<WifiNetDevice> (apDevice.Get (0)));
+      for (uint32_t j = 0; j < nWifi; j++)
+        {
+          bssDevices[b].push_back (DynamicCast<WifiNetDevice> (staDevice.Get (j)));
+        }
+      for (uint32_t j = 0; j <= nWifi; j++)
+        {
+          AssignDeviceStreams (wifi, bssDevices[b][j], b * (nWifi + 1) + j);
+          if (!ampdu)
+            {
+              bssDevices[b][j]->GetMac ()->SetAttribute ("BE_MaxAmpduSize", UintegerValue (0));
+            }
+        }
+
+      stack.Install (apNodes[b]);
+      stack.Install (staNodes[b]);
+
+      wifiAddress.SetBase (("10." + std::to_string (b + 1) + ".0.0").c_str (), "255.255.255.0");
+      wifiAddress.Assign (apDevice);
+      wifiAddress.Assign (staDevice);
+
+      // The link is a remote channel when the BSS runs on another rank than the core
+      NetDeviceContainer backhaulDevices = backhaul.Install (apNodes[b].Get (0), coreNode.Get (0));
+      backhaulAddress.Assign (backhaulDevices);
+      backhaulAddress.NewNetwork ();
+    }
+
+  if (sinkAtCore)
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+
+  // Configure applications and traces of the local BSSs, the counters of a remote sink are summed at rank 0
+  windowCounters.assign (nBss * nWifi * N_STATION_FIELDS, 0.);
+  totalCounters.assign (nBss * nWifi * N_STATION_FIELDS, 0.);
+  agentLatency.resize (useMabAgent ? nBss * cheaterNumber : 0);
+
+  DataRate applicationDataRate = DataRate (dataRate * 1e6);
+  uint32_t portNumber = 9;
+
+  for (uint32_t b = 0; b < nBss; b++)
+    {
+      for (uint32_t j = 0; j < nWifi; j++)
+        {
+          // Interface 1 of an AP is its Wi-Fi device, the backhaul link of BSS b is interface b + 1 of the core
+          uint32_t stationIndex = b * nWifi + j;
+          if (sinkAtCore)
+            {
+              InstallTrafficGenerator (staNodes[b].Get (j), coreNode.Get (0), b + 1, portNumber++,
+                                       applicationDataRate, packetSize, stationIndex);
+            }
+          else
+            {
+              InstallTrafficGenerator (staNodes[b].Get (j), apNodes[b].Get (0), 1, portNumber++,
+                                       applicationDataRate, packetSize, stationIndex);
+            }
+
+          if (GetBssRank (b) == rank)
+            {
+              bssDevices[b][j + 1]->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&MonitorRetransmissions, stationIndex));
+            }
+        }
+
+      if (GetBssRank (b) == rank && agentName == "wifi" && cw_idx >= 0)
+        {
+          for (uint32_t j = 1; j <= nWifi; j++)
+            {
+              Ptr<QosTxop> txop = bssDevices[b][j]->GetMac ()->GetQosTxop (AC_BE);
+              txop->SetMinCw (pow (2, 4 + cw_idx));
+              txop->SetMaxCw (pow (2, 4 + cw_idx));
+            }
+        }
+    }
+
+  if (rank == 0)
+    {
+      csvLogOutput << "time,bss,throughput,fairness,plr,latency" << std::endl;
+      m_env->SetCond (2, 0);
+    }
+  Simulator::Schedule (Seconds (fuzzTime), &ExecuteAction, agentName, dataRate);
+
+  // Record start time
+  if (rank == 0)
+    {
+      std::cout << "Starting simulation..." << std::endl;
+    }
+  auto start = std::chrono::high_resolution_clock::now ();
+
+  // Run the simulation!
+  Simulator::Run ();
+
+  // Record stop time and count duration
+  auto finish = std::chrono::high_resolution_clock::now ();
+  std::chrono::duration<double> elapsed = finish - start;
+  double wallTime = elapsed.count ();
+
+  // Sum the counters and the events of all ranks
+  std::vector<double> counters = totalCounters;
+  counters.push_back (Simulator::GetEventCount ());
+  ReduceToRoot (counters);
+  double events = counters.back ();
+  counters.pop_back ();
+
+  if (rank == 0)
+    {
+      std::cout << "Done!" << std::endl
+                << "Elapsed time: " << wallTime << " s" << std::endl
+                << "Events: " << events << " (" << events / wallTime << " events/s on " << ranks << " ranks)" << std::endl
+                << std::endl;
+
+      // Per-BSS results
+      std::ofstream bssFile (bssCsvPath);
+      bssFile << "bss,rank,channel,throughput,fairness,plr,latency" << std::endl;
+      for (uint32_t b = 0; b < nBss; b++)
+        {
+          std::vector<double> bssCounters (counters.begin () + b * nWifi * N_STATION_FIELDS,
+                                           counters.begin () + (b + 1) * nWifi * N_STATION_FIELDS);
+          WriteBssMetrics (bssFile, bssCounters, simulationTime,
+                           std::to_string (b) + "," + std::to_string (GetBssRank (b)) + "," + std::to_string (CHANNELS[b % N_CHANNELS]));
+        }
+
+      // Network results, over all stations of all BSSs
+      double jainsIndexN = 0.;
+      double jainsIndexD = 0.;
+      double nWifiReal = 0.;
+      double txSum = 0.;
+      double rxSum = 0.;
+      double delaySum = 0.;
+      double cheaterTHR = 0.;
+      double normalTHR = 0.;
+
+      for (uint32_t s = 0; s < nBss * nWifi; s++)
+        {
+          double *station = &counters[s * N_STATION_FIELDS];
+          double flow = 8 * station[RX_BYTES] / (1e6 * simulationTime);
+
+          if (flow > 0)
+            {
+              nWifiReal += 1;
+            }
+          jainsIndexN += flow;
+          jainsIndexD += flow * flow;
+          txSum += station[TX_PACKETS];
+          rxSum += station[RX_PACKETS];
+          delaySum += station[DELAY_SUM];
+
+          if (useMabAgent && (int) (s % nWifi) < cheaterNumber)
+            {
+              cheaterTHR += flow;
+            }
+          else
+            {
+              normalTHR += flow;
+            }
+        }
+
+      double totalThr = jainsIndexN;
+      double fairnessIndex = jainsIndexD > 0 ? jainsIndexN * jainsIndexN / (nWifiReal * jainsIndexD) : 0.;
+      double totalPLR = txSum > 0 ? std::max (0., txSum - rxSum) / txSum : 0.;
+      double latencyPerPacket = rxSum > 0 ? delaySum / rxSum : 0.;
+
+      std::cout << "Network throughput: " << totalThr << " Mb/s" << std::endl
+                << "Jain's fairness index: " << fairnessIndex << std::endl
+                << "PLR: " << totalPLR << std::endl
+                << "Latency per packet: " << latencyPerPacket << " s" << std::endl
+                << std::endl;
+
+      // Gather results in CSV format
+      std::ostringstream csvOutput;
+      csvOutput << "agent,dataRate,distance,nBss,nWifi,ranks,seed,warmupEnd,fairness,latency,plr,throughput,cheaterTHR,normalTHR,cheaterNumber,wallTime,events" << std::endl;
+      csvOutput << agentName << "," << dataRate << "," << distance << "," << nBss << "," << nWifi << "," << ranks << ","
+                << RngSeedManager::GetRun () << "," << warmupEndTime << "," << fairnessIndex << ","
+                << latencyPerPacket << "," << totalPLR << "," << totalThr << "," << cheaterTHR << ","
+                << normalTHR << "," << cheaterNumber << "," << wallTime << "," << events << std::endl;
+
+      // Print results to files
+      std::ofstream outputFile (csvPath);
+      outputFile << csvOutput.str ();
+      std::cout << "Simulation data saved to: " << csvPath << std::endl
+                << "Per-BSS results saved to: " << bssCsvPath << std::endl;
+
+      std::ofstream outputLogFile (csvLogPath);
+      outputLogFile << csvLogOutput.str ();
+
+      m_env->SetFinish ();
+    }
+
+  // Clean-up
+  Simulator::Destroy ();
+
+#ifdef NS3_MPI
+  MPI_Comm_free (&bssComm);
+  MpiInterface::Disable ();
+#endif
+
+  return 0;
+}
+
+/***** Function definitions *****/
+
+void
+ReduceToRoot (std::vector<double> &values)
+{
+#ifdef NS3_MPI
+  if (ranks > 1)
+    {
+      std::vector<double> sum (values.size (), 0.);
+      MPI_Reduce (values.data (), sum.data (), values.size (), MPI_DOUBLE, MPI_SUM, 0, bssComm);
+      values.swap (sum);
+    }
+#endif
+}
+
+void
+BroadcastFromRoot (std::vector<double> &values)
+{
+#ifdef NS3_MPI
+  if (ranks > 1)
+    {
+      MPI_Bcast (values.data (), values.size (), MPI_DOUBLE, 0, bssComm);
+    }
+#endif
+}
+
+// Runs at the same simulated time on all ranks. With the granted-time-window
+// synchronization of DistributedSimulatorImpl, all ranks reach it within the same
+// window, so the blocking collectives below cannot deadlock the simulator.
+void
+ExecuteAction (std::string agentName, double dataRate)
+{
+  std::vector<double> window = windowCounters;
+  std::fill (windowCounters.begin (), windowCounters.end (), 0.);
+  ReduceToRoot (window);
+
+  // Each agent's station is on a single rank, the sum of the histograms of all ranks is its histogram
+  std::vector<double> latency (agentLatency.size () * LatencyHistogram::SERIALIZED_SIZE);
+  for (uint32_t a = 0; a < agentLatency.size (); a++)
+    {
+      agentLatency[a].Serialize (&latency[a * LatencyHistogram::SERIALIZED_SIZE]);
+      agentLatency[a].Reset ();
+    }
+  ReduceToRoot (latency);
+
+  // CW indices of the agents (-1 - no change) and the end of the warmup
+  uint32_t nAgents = nBss * cheaterNumber;
+  std::vector<double> actions (nAgents + 1, -1.);
+
+  if (rank == 0)
+    {
+      double now = Simulator::Now ().GetSeconds () - fuzzTime;
+      for (uint32_t b = 0; b < nBss; b++)
+        {
+          std::vector<double> bssCounters (window.begin () + b * nWifi * N_STATION_FIELDS,
+                                           window.begin () + (b + 1) * nWifi * N_STATION_FIELDS);
+          WriteBssMetrics (csvLogOutput, bssCounters, interactionTime,
+                           std::to_string (now) + "," + std::to_string (b));
+        }
+
+      if (useMabAgent)
+        {
+          // Agent a controls station a % cheaterNumber of BSS a / cheaterNumber
+          auto env = m_env->EnvSetterCond ();
+          env->fairness = 0;
+          env->latency = 0;
+          env->plr = 0;
+          for (uint32_t a = 0; a < nAgents; a++)
+            {
+              uint32_t b = a / cheaterNumber;
+              double *station = &window[(b * nWifi + a % cheaterNumber) * N_STATION_FIELDS];
+              LatencyHistogram stationLatency;
+              stationLatency.AddSerialized (&latency[a * LatencyHistogram::SERIALIZED_SIZE]);
+
+              env->tx_list[a] = station[RX_BYTES];
+              env->lost_list[a] = std::max (0., station[TX_PACKETS] - station[RX_PACKETS]);
+              env->throughput[a] = 8 * station[RX_BYTES] / (1e6 * interactionTime);
+              env->collisions[a] = station[RETRIES];
+              env->latency_p50[a] = stationLatency.GetPercentile (0.5);
+              env->latency_p95[a] = stationLatency.GetPercentile (0.95);
+              env->latency_p99[a] = stationLatency.GetPercentile (0.99);
+              env->latency_p999[a] = stationLatency.GetPercentile (0.999);
+            }
+          env->schedule_len = 0;
+          env->time = now;
+          m_env->SetCompleted ();
+
+          auto act = m_env->ActionGetterCond ();
+          for (uint32_t a = 0; a < nAgents; a++)
+            {
+              actions[a] = act->cw[a];
+            }
+          actions[nAgents] = act->end_warmup;
+          m_env->GetCompleted ();
+        }
+      else
+        {
+          actions[nAgents] = 1.;
+        }
+    }
+
+  BroadcastFromRoot (actions);
+
+  for (uint32_t a = 0; a < nAgents; a++)
+    {
+      uint32_t b = a / cheaterNumber;
+      if (GetBssRank (b) == rank)
+        {
+          SetNetworkConfigurationCheater (actions[a], b, a % cheaterNumber + 1);
+        }
+    }
+
+  if (!simulationPhase && actions[nAgents] > 0)
+    {
+      std::fill (totalCounters.begin (), totalCounters.end (), 0.);
+      Simulator::Stop (Seconds (simulationTime));
+      simulationPhase = true;
+      warmupEndTime = Simulator::Now ().GetSeconds () - fuzzTime;
+      if (rank == 0)
+        {
+          std::cout << "Warmup period finished after " << warmupEndTime << " s" << std::endl;
+        }
+    }
+
+  Simulator::Schedule (Seconds (interactionTime), &ExecuteAction, agentName, dataRate);
+}
+
+void
+WriteBssMetrics (std::ostream &output, const std::vector<double> &counters, double duration,
+                 std::string prefix)
+{
+  double jainsIndexN = 0.;
+  double jainsIndexD = 0.;
+  double nWifiReal = 0.;
+  double tx = 0.;
+  double rx = 0.;
+  double delaySum = 0.;
+
+  for (uint32_t j = 0; j < nWifi; j++)
+    {
+      const double *station = &counters[j * N_STATION_FIELDS];
+      double flow = 8 * station[RX_BYTES] / (1e6 * duration);
+
+      if (flow > 0)
+        {
+          nWifiReal += 1;
+        }
+      jainsIndexN += flow;
+      jainsIndexD += flow * flow;
+      tx += station[TX_PACKETS];
+      rx += station[RX_PACKETS];
+      delaySum += station[DELAY_SUM];
+    }
+
+  output << prefix << "," << jainsIndexN << ","
+         << (jainsIndexD > 0 ? jainsIndexN * jainsIndexN / (nWifiReal * jainsIndexD) : 0.) << ","
+         << (tx > 0 ? std::max (0., tx - rx) / tx : 0.) << "," << (rx > 0 ? delaySum / rx : 0.) << std::endl;
+}
+
+void
+SetNetworkConfigurationCheater (int cw_idx, uint32_t bss, uint32_t station)
+{
+  if (cw_idx >= 0)
+    {
+      Ptr<QosTxop> txop = bssDevices[bss][station]->GetMac ()->GetQosTxop (AC_BE);
+      txop->SetMinCw (pow (2, cw_idx));
+    }
+}
+
+void
+InstallTrafficGenerator (Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, uint32_t sinkInterface,
+                         uint32_t port, DataRate offeredLoad, uint32_t packetSize, uint32_t stationIndex)
+{
+  // Get sink address
+  Ptr<Ipv4> ipv4 = toNode->GetObject<Ipv4> ();
+  Ipv4Address addr = ipv4->GetAddress (sinkInterface, 0).GetLocal ();
+  InetSocketAddress sinkSocket (addr, port);
+
+  // Add random fuzz to app start time, from a stream of the station
+  ScopedRngRun environmentRun (crnRun);
+  Ptr<UniformRandomVariable> fuzz = CreateObject<UniformRandomVariable> ();
+  fuzz->SetAttribute ("Min", DoubleValue (0.));
+  fuzz->SetAttribute ("Max", DoubleValue (fuzzTime));
+  fuzz->SetStream (FUZZ_STREAM + stationIndex);
+  double applicationsStart = fuzz->GetValue ();
+
+  // Applications are installed only on the rank of their node
+  if (toNode->GetSystemId () == rank)
+    {
+      PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket);
+      packetSinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+
+      ApplicationContainer sinkApplications (packetSinkHelper.Install (toNode));
+      sinkApplications.Get (0)->TraceConnectWithoutContext ("RxWithSeqTsSize", MakeBoundCallback (&SinkRx, stationIndex));
+      sinkApplications.Start (Seconds (applicationsStart));
+    }
+
+  if (fromNode->GetSystemId () == rank)
+    {
+      OnOffHelper onOffHelper ("ns3::UdpSocketFactory", sinkSocket);
+      onOffHelper.SetConstantRate (offeredLoad, packetSize);
+      onOffHelper.SetAttribute ("Tos", UintegerValue (0x70)); // AC_BE
+      onOffHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+
+      ApplicationContainer sourceApplications (onOffHelper.Install (fromNode));
+      onOffHelper.AssignStreams (NodeContainer (fromNode), TRAFFIC_STREAM + 2 * stationIndex);
+      sourceApplications.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&SourceTx, stationIndex));
+      sourceApplications.Start (Seconds (applicationsStart));
+    }
+}
+
+void
+SinkRx (uint32_t stationIndex, Ptr<const Packet> packet, const Address &from,
+        const Address &to, const SeqTsSizeHeader &header)
+{
+  Time delay = Simulator::Now () - header.GetTs ();
+  for (auto counters : {&windowCounters, &totalCounters})
+    {
+      double *station = &(*counters)[stationIndex * N_STATION_FIELDS];
+      station[RX_BYTES] += packet->GetSize ();
+      station[RX_PACKETS]++;
+      station[DELAY_SUM] += delay.GetSeconds ();
+    }
+
+  // Station j of BSS b is the station of agent b * cheaterNumber + j
+  uint32_t j = stationIndex % nWifi;
+  if (useMabAgent && (int) j < cheaterNumber)
+    {
+      agentLatency[stationIndex / nWifi * cheaterNumber + j].Record (delay.GetNanoSeconds ());
+    }
+}
+
+void
+SourceTx (uint32_t stationIndex, Ptr<const Packet> packet)
+{
+  windowCounters[stationIndex * N_STATION_FIELDS + TX_PACKETS]++;
+  totalCounters[stationIndex * N_STATION_FIELDS + TX_PACKETS]++;
+}
+
+void
+MonitorRetransmissions (uint32_t stationIndex, Ptr<const Packet> packet)
+{
+  WifiMacHeader header;
+  if (packet->PeekHeader (header) && header.IsRetry ())
+    {
+      windowCounters[stationIndex * N_STATION_FIELDS + RETRIES]++;
+      totalCounters[stationIndex * N_STATION_FIELDS + RETRIES]++;
+    }
+}
@@ -0,0 +1,1111 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/ns3-ai-module.h"
+
+#include "memory-usage.h"
+#include "ns3-ai-structures.h"
+#include "random-streams.h"
+#include "rolling-metrics.h"
+
+/*
+ * Analytical surrogate of scenario_mgr_multi_agent.
+ *
+ * Contention between the stations is modelled with the Bianchi fixed point extended
+ * to heterogeneous per-station EDCA parameters and to non-saturated stations. Every
+ * interaction window is sampled from the stationary solution instead of being
+ * simulated packet by packet, and the observations are exchanged with the agents
+ * through the same sEnv/sAct structures as in the packet-level scenario.
+ *
+ * The MAC/PHY timing follows 802.11ax single-user transmissions with the highest
+ * MCS (IdealWifiManager at short distances) and uplink traffic only, so the AP
+ * never contends. Two parameters that depend on the ns-3 implementation details
+ * (mean A-MPDU length and extra per-transmission overhead) can be fitted to
+ * results of the packet-level scenario with --calibrationPath.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("scenario");
+
+Ns3AIRL<sEnv, sAct> * m_env = new Ns3AIRL<sEnv, sAct> (DEFAULT_MEMBLOCK_KEY);
+
+/***** Model constants *****/
+
+const double SLOT = 9e-6;
+const double SIFS = 16e-6;
+const double HE_PREAMBLE = 48e-6;     // L-STF, L-LTF, L-SIG, RL-SIG, HE-SIG-A, HE-STF, HE-LTF
+const double HE_SYMBOL = 13.6e-6;     // 12.8 us + 0.8 us GI
+const double LEGACY_PREAMBLE = 20e-6;
+const double LEGACY_SYMBOL = 4e-6;
+const double LEGACY_BITS_PER_SYMBOL = 96.;  // 24 Mb/s control rate
+
+const uint32_t MPDU_OVERHEAD = 74;    // IP/UDP + LLC + QoS MAC header + FCS + A-MPDU delimiter and padding (B)
+const uint32_t DEFAULT_CW_MIN = 15;
+const uint32_t DEFAULT_CW_MAX = 1023;
+const uint32_t DEFAULT_AIFSN = 3;
+const uint32_t FRAME_RETRY_LIMIT = 7; // transmission attempts of a frame
+const uint32_t MAX_AMPDU_SIZE = 65535;
+
+/***** Model structures *****/
+
+// EDCA and traffic settings of a station
+struct StationConfig
+{
+  uint32_t cwMin = DEFAULT_CW_MIN;
+  uint32_t cwMax = DEFAULT_CW_MAX;
+  uint32_t aifsn = DEFAULT_AIFSN;
+  uint32_t txopLimit = 0;           // us
+  uint32_t ampduSize = MAX_AMPDU_SIZE; // B
+  uint32_t rtsThreshold = 65535;    // B
+  double offeredLoad = 0.;          // packets/s
+};
+
+// Stationary solution for a station
+struct StationState
+{
+  double tau = 0.;          // transmission attempt probability per slot
+  double p = 0.;            // conditional collision probability
+  double ps = 0.;           // probability of a successful transmission of the station per slot
+  double pf = 0.;           // probability of a failed transmission of the station per slot
+  double mpdus = 1.;        // MPDUs per PPDU
+  double bursts = 1.;       // PPDUs per TXOP
+  double txopTime = 0.;     // duration of a successful TXOP (s)
+  double collisionTime = 0.; // duration of a collision (s)
+  double accessRate = 0.;   // successful channel accesses per second when backlogged
+  double capacity = 0.;     // packets/s when backlogged
+  double delivered = 0.;    // packets/s
+  double retried = 0.;      // retransmitted MPDUs/s
+  double dropped = 0.;      // packets/s lost at the retry limit or the queue
+  double serviceTime = 0.;  // s
+  double queueDelay = 0.;   // s
+};
+
+// Parameters fitted in the calibration mode
+struct SurrogateParams
+{
+  double ampduLength = 0.;  // mean MPDUs per A-MPDU (0 - as many as fit in the A-MPDU size)
+  double extraOverhead = 0.; // s
+};
+
+/***** Functions declarations *****/
+
+void splitString (std::string& input, char delimiter, std::string arr[], int& index)
+{
+  std::istringstream stream (input);
+  std::string token;
+  while (getline (stream, token, delimiter))
+    {
+      arr[index++] = token;
+    }
+}
+
+double HeBitsPerSymbol (uint32_t channelWidth);
+double PpduDuration (double bytes);
+double LegacyDuration (uint32_t bytes);
+double SlotTime (const std::vector<StationState> &state);
+void SolveFixedPoint (const std::vector<StationConfig> &config, std::vector<StationState> &state);
+bool ExecuteAction (std::string agentName, uint32_t nWifi, int cheaterNumber);
+void SampleWindow (double duration);
+void SampleSchedule (double duration, int cheaterNumber);
+void UpdateRollingMetrics (double duration);
+void SetNetworkConfigurationCheater (int cw_idx, int cheaterNum);
+void SetEdcaConfigurationCheater (int aifsn, int txopLimit, int ampduSize, int rtsThreshold, int cheaterNum);
+void ParseActionDims (std::string actionDims);
+void Calibrate (std::string calibrationPath, std::string paramsPath, uint32_t packetSize,
+                double defaultDataRate);
+bool LoadParams (std::string paramsPath);
+double SampleCount (double mean);
+
+/***** Global variables and constants *****/
+
+double fuzzTime = 5.;
+double simulationTime = 5.;
+double interactionTime = 0.5;
+double warmupEndTime = 0.;
+bool simulationPhase = false;
+bool useMabAgent = false;
+bool useNoise = true;
+
+bool actionCw = true;
+bool actionAifsn = false;
+bool actionTxop = false;
+bool actionAmpdu = false;
+bool actionRts = false;
+
+double now = 0.;
+double stopTime = 0.;
+double periodLength = 0.5;           // time between the last two exchanges with the agents
+
+// Schedule received with the last action and the observations of its entries (see sAct)
+int scheduleLen = 0;
+int scheduleObserved = 0;
+double scheduleDuration[MAX_SCHEDULE];
+int scheduleCw[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleTx[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleLost[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleThroughput[MAX_SCHEDULE][MAX_AGENTS];
+double scheduleCollisions[MAX_SCHEDULE][MAX_AGENTS];
+
+double bitsPerSymbol = 1950.;        // HE MCS 11, 1 SS, 20 MHz
+uint32_t mpduLength = 1500 + MPDU_OVERHEAD;
+uint32_t payloadSize = 1500;
+uint32_t queueSize = 100;
+SurrogateParams params;
+
+std::vector<StationConfig> stationConfig;
+std::vector<StationState> stationState;
+
+// Last window observations and totals since the warmup end of each station
+std::vector<double> windowRxBytes, windowCollisions, windowLost, windowOffered;
+std::vector<double> totalRxBytes, totalLost, totalOffered, totalDelaySum, totalDelivered;
+
+// Aggregates of the window observations of each station (see sEnv)
+uint32_t metricsWindow = 10;
+double metricsAlpha = 0.2;
+std::vector<RollingMetric> rollingThroughput, rollingCollisionRatio, rollingPlr;
+IncrementalJain ewmaFairness, windowFairness;
+double stepFairness = 1.;
+
+Ptr<NormalRandomVariable> noise;
+
+std::ostringstream csvLogOutput;
+
+/***** Main with scenario definition *****/
+
+int
+main (int argc, char *argv[])
+{
+  // Initialize default simulation parameters
+  uint32_t nWifi = 10;
+  uint32_t maxQueueSize = 100;
+  uint32_t packetSize = 1500;
+  uint32_t dataRate = 110;
+  uint32_t channelWidth = 20;
+  int cheaterNumber = 1;
+  double distance = 10.;
+
+  std::string agentName = "wifi";
+  std::string csvPath = "results.csv";
+  std::string csvLogPath = "logs.csv";
+  std::string actionDims = "cw";
+  std::string calibrationPath = "";
+  std::string paramsPath = "surrogate_params.txt";
+  int64_t crnRun = -1;
+  std::string queueDisc = "fifo";
+
+  int cw_idx = -1;
+  bool rts_cts = false;
+  bool ampdu = true;
+
+  // Parse command line arguments (the model options of scenario_mgr_multi_agent, so that the agents can use both)
+  CommandLine cmd;
+  cmd.AddValue ("actionDims", "Comma separated action dimensions controlled by the agents (cw,aifsn,txop,ampdu,rts)", actionDims);
+  cmd.AddValue ("agentName", "Name of the agent", agentName);
+  cmd.AddValue ("ampdu", "Enable A-MPDU", ampdu);
+  cmd.AddValue ("calibrationPath", "Fit the model to results CSV of scenario_mgr_multi_agent and exit (empty - disabled)", calibrationPath);
+  cmd.AddValue ("channelWidth", "Channel width (MHz)", channelWidth);
+  cmd.AddValue ("crnRun", "Common random numbers: draw the observation noise from this run instead of RngRun (-1 - disabled)", crnRun);
+  cmd.AddValue ("csvLogPath", "Path to output CSV log file", csvLogPath);
+  cmd.AddValue ("csvPath", "Path to output CSV file", csvPath);
+  cmd.AddValue ("cw", "Contention window (const CW = 2 ^ (4 + x) if x >= 0) (only for wifi agent)", cw_idx);
+  cmd.AddValue ("dataRate", "Traffic generator data rate (Mb/s)", dataRate);
+  cmd.AddValue ("distance", "Max distance between AP and STAs (m) (not modelled)", distance);
+  cmd.AddValue ("fuzzTime", "Maximum fuzz value (s)", fuzzTime);
+  cmd.AddValue ("interactionTime", "Time between agent actions (s)", interactionTime);
+  cmd.AddValue ("maxQueueSize", "Max queue size (packets)", maxQueueSize);
+  cmd.AddValue ("metricsAlpha", "Smoothing factor of the exponentially weighted metrics of the stations", metricsAlpha);
+  cmd.AddValue ("metricsWindow", "Number of interactions of the sliding-window metrics of the stations", metricsWindow);
+  cmd.AddValue ("nWifi", "Number of stations", nWifi);
+  cmd.AddValue ("noise", "Sample the per-window counts around the model mean", useNoise);
+  cmd.AddValue ("packetSize", "Packets size (B)", packetSize);
+  cmd.AddValue ("paramsPath", "Path to the fitted model parameters (read if exists, written by the calibration)", paramsPath);
+  cmd.AddValue ("queueDisc", "Root queue disc of the stations (only fifo is modelled)", queueDisc);
+  cmd.AddValue ("rtsCts", "Enable RTS/CTS", rts_cts);
+  cmd.AddValue ("simulationTime", "Duration of simulation (s)", simulationTime);
+  cmd.AddValue ("cheaterNumber", "Number of cheaters in network", cheaterNumber);
+  cmd.Parse (argc, argv);
+
+  if (queueDisc != "fifo")
+    {
+      NS_FATAL_ERROR ("The surrogate models only the fifo queue disc, not " << queueDisc);
+    }
+  if (cheaterNumber < 0 || cheaterNumber > MAX_AGENTS)
+    {
+      NS_FATAL_ERROR ("At most " << MAX_AGENTS << " cheaters, got " << cheaterNumber);
+    }
+
+  ParseActionDims (actionDims);
+  periodLength = interactionTime;
+
+  bitsPerSymbol = HeBitsPerSymbol (channelWidth);
+  mpduLength = packetSize + MPDU_OVERHEAD;
+  payloadSize = packetSize;
+  queueSize = maxQueueSize;
+
+  if (!calibrationPath.empty ())
+    {
+      Calibrate (calibrationPath, paramsPath, packetSize, dataRate);
+      m_env->SetFinish ();
+      return 0;
+    }
+
+  bool paramsLoaded = LoadParams (paramsPath);
+
+  // Print simulation settings to screen
+  std::cout << std::endl
+            << "Simulating an analytical model of IEEE 802.11ax devices with the following settings:" << std::endl
+            << "- agent: " << agentName << std::endl
+            << "- max data rate: " << dataRate << " Mb/s" << std::endl
+            << "- channel width: " << channelWidth << " Mhz" << std::endl
+            << "- packets size: " << packetSize << " B" << std::endl
+            << "- max queue size: " << maxQueueSize << " packets" << std::endl
+            << "- number of stations: " << nWifi << std::endl
+            << "- simulation time: " << simulationTime << " s" << std::endl
+            << "- max fuzz time: " << fuzzTime << " s" << std::endl
+            << "- interaction time: " << interactionTime << " s" << std::endl
+            << "- RTS/CTS: " << (rts_cts ? "enabled" : "disabled") << std::endl
+            << "- A-MPDU: " << (ampdu ? "enabled" : "disabled") << std::endl
+            << "- model parameters: " << (paramsLoaded ? paramsPath : "default")
+            << " (A-MPDU length " << params.ampduLength << ", extra overhead " << params.extraOverhead * 1e6 << " us)" << std::endl;
+
+  if (agentName == "wifi")
+    {
+      std::cout << "- CW: " << (cw_idx >= 0 ? "2 ^ (4 + " + std::to_string (cw_idx) + ")" : "default" ) << std::endl;
+    }
+  else
+    {
+      std::cout << "- action dimensions: " << actionDims << std::endl;
+    }
+
+  useMabAgent = agentName != "wifi";
+
+  noise = CreateObject<NormalRandomVariable> ();
+  {
+    ScopedRngRun environmentRun (crnRun);
+    noise->SetStream (FUZZ_STREAM);
+  }
+
+  // Configure stations like the packet-level scenario does
+  StationConfig defaultConfig;
+  defaultConfig.ampduSize = ampdu ? MAX_AMPDU_SIZE : 0;
+  defaultConfig.rtsThreshold = rts_cts ? 0 : 65535;
+  defaultConfig.offeredLoad = dataRate * 1e6 / (8. * packetSize);
+
+  if (agentName == "wifi" && cw_idx >= 0)
+    {
+      defaultConfig.cwMin = pow (2, 4 + cw_idx);
+      defaultConfig.cwMax = pow (2, 4 + cw_idx);
+    }
+
+  stationConfig.assign (nWifi, defaultConfig);
+  stationState.assign (nWifi, StationState ());
+
+  for (auto list : {&windowRxBytes, &windowCollisions, &windowLost, &windowOffered,
+                    &totalRxBytes, &totalLost, &totalOffered, &totalDelaySum, &totalDelivered})
+    {
+      list->assign (nWifi, 0.);
+    }
+  for (auto list : {&rollingThroughput, &rollingCollisionRatio, &rollingPlr})
+    {
+      list->assign (nWifi, RollingMetric ());
+      for (auto &metric : *list)
+        {
+          metric.Configure (metricsWindow, metricsAlpha);
+        }
+    }
+  ewmaFairness.Resize (nWifi);
+  windowFairness.Resize (nWifi);
+
+  csvLogOutput << "time,station,cwMin,tau,collisionProbability,throughput,collisions,lost" << std::endl;
+
+  m_env->SetCond (2, 0);
+
+  // Record start time
+  std::cout << "Starting simulation..." << std::endl;
+  auto start = std::chrono::high_resolution_clock::now ();
+
+  // Interaction windows follow each other until the simulation phase ends
+  now = fuzzTime;
+  uint64_t windows = 1;
+  while (ExecuteAction (agentName, nWifi, cheaterNumber))
+    {
+      windows++;
+    }
+
+  // Record stop time and count duration
+  auto finish = std::chrono::high_resolution_clock::now ();
+  std::chrono::duration<double> elapsed = finish - start;
+
+  std::cout << "Done!" << std::endl
+            << "Elapsed time: " << elapsed.count () << " s" << std::endl
+            << std::endl;
+
+  // Calculate per-station throughput and Jain's fairness index
+  double nWifiReal = 0;
+  double jainsIndexN = 0.;
+  double jainsIndexD = 0.;
+  double lostSum = 0.;
+  double txSum = 0.;
+  double delaySum = 0.;
+  double deliveredSum = 0.;
+
+  std::cout << "Results: " << std::endl;
+
+  for (uint32_t i = 0; i < nWifi; i++)
+    {
+      double flow = 8 * totalRxBytes[i] / (1e6 * simulationTime);
+
+      if (flow > 0)
+        {
+          nWifiReal += 1;
+        }
+
+      jainsIndexN += flow;
+      jainsIndexD += flow * flow;
+
+      lostSum += totalLost[i];
+      txSum += totalOffered[i];
+      delaySum += totalDelaySum[i];
+      deliveredSum += totalDelivered[i];
+      std::cout << "Station " << i << "\tThroughput: " << flow << " Mb/s" << std::endl;
+    }
+
+  double totalThr = jainsIndexN;
+  double fairnessIndex = jainsIndexN * jainsIndexN / (nWifiReal * jainsIndexD);
+  double totalPLR = txSum > 0 ? lostSum / txSum : 0.;
+  double latencyPerPacketTotal = deliveredSum > 0 ? delaySum / deliveredSum : 0.;
+  double normalTHR = 0;
+  double cheaterTHR = 0;
+  double normalAvgTHR = 0;
+  double cheaterAvgTHR = 0;
+
+  if (agentName != "wifi")
+    {
+      for (int i = 0; i < cheaterNumber; i++)
+        {
+          cheaterTHR += 8 * totalRxBytes[i] / (1e6 * simulationTime);
+        }
+      for (uint32_t i = cheaterNumber; i < nWifi; i++)
+        {
+          normalTHR += 8 * totalRxBytes[i] / (1e6 * simulationTime);
+        }
+
+      normalAvgTHR = normalTHR / (nWifi - cheaterNumber);
+      cheaterAvgTHR = cheaterTHR / (cheaterNumber);
+
+      std::cout << std::endl
+                << "Cheater throughput: " << cheaterTHR << " Mb/s" << std::endl
+                << "Normal STA avg throughput: " << normalAvgTHR << " Mb/s" << std::endl;
+    }
+  else
+    {
+      normalAvgTHR = totalThr / (nWifi);
+      std::cout << std::endl
+                << "Network avg throughput: " << normalAvgTHR << " Mb/s" << std::endl;
+    }
+
+  // Network latency percentiles as the packet-weighted mean of the per-station model percentiles
+  double latencyPercentiles[4] = {0., 0., 0., 0.};
+  double quantiles[4] = {0.5, 0.95, 0.99, 0.999};
+  for (uint32_t i = 0; i < nWifi && deliveredSum > 0; i++)
+    {
+      for (int k = 0; k < 4; k++)
+        {
+          double percentile = stationState[i].serviceTime - stationState[i].queueDelay * std::log (1 - quantiles[k]);
+          latencyPercentiles[k] += percentile * totalDelivered[i] / deliveredSum;
+        }
+    }
+
+  // Print results
+  std::cout << std::endl
+            << "Network throughput: " << totalThr << " Mb/s" << std::endl
+            << "Jain's fairness index: " << fairnessIndex << std::endl
+            << "PLR: " << totalPLR << std::endl
+            << "Latency per packet: " << latencyPerPacketTotal << std::endl
+            << "Latency p50/p95/p99/p99.9: " << latencyPercentiles[0] << " / " << latencyPercentiles[1] << " / "
+            << latencyPercentiles[2] << " / " << latencyPercentiles[3] << " s" << std::endl
+            << "Total Lost packets: " << lostSum << std::endl
+            << "Total tx packets: " << txSum << std::endl
+            << "Total rx packets: " << deliveredSum << std::endl
+            << std::endl;
+
+  // Gather results in CSV format (columns of scenario_mgr_multi_agent, the detector is not modelled)
+  std::ostringstream csvOutput;
+  csvOutput << "agent,dataRate,distance,nWifi,nWifiReal,seed,warmupEnd,fairness,latency,plr,throughput,cheaterTHR,cheaterAvgTHR,normalTHR,normalAvgTHR,cheaterNumber,setupTime,detectedCheaters,falsePositives,meanTimeToDetect,latencyP50,latencyP95,latencyP99,latencyP999,peakRss,packetsAllocated,flowmonTracked,peakQdiscPackets,peakMacQueuePackets,memoryBoundTime,scheduler,wallTime,events"<< std::endl;
+  csvOutput << agentName << "," << dataRate << "," << distance << "," << nWifi << "," << nWifiReal << ","
+            << RngSeedManager::GetRun () << "," << warmupEndTime << "," << fairnessIndex << ","
+            << latencyPerPacketTotal << "," << totalPLR << "," << totalThr << ","
+            << cheaterTHR << "," << cheaterAvgTHR << "," << normalTHR << "," << normalAvgTHR << "," << cheaterNumber << ","
+            << 0. << "," << 0 << "," << 0 << "," << -1. << ","
+            << latencyPercentiles[0] << "," << latencyPercentiles[1] << ","
+            << latencyPercentiles[2] << "," << latencyPercentiles[3] << ","
+            << GetPeakRss () << "," << 0 << "," << 0 << "," << 0 << "," << 0 << "," << -1. << ","
+            << "analytical" << "," << elapsed.count () << "," << windows << std::endl;
+
+  // Print results to files
+  std::ofstream outputFile (csvPath);
+  outputFile << csvOutput.str ();
+  std::cout << std::endl << "Simulation data saved to: " << csvPath;
+
+  std::ofstream outputLogFile (csvLogPath);
+  outputLogFile << csvLogOutput.str ();
+  std::cout << std::endl << "Simulation log saved to: " << csvLogPath << std::endl << std::endl;
+
+  m_env->SetFinish ();
+
+  return 0;
+}
+
+/***** Function definitions *****/
+
+double
+HeBitsPerSymbol (uint32_t channelWidth)
+{
+  // Data subcarriers of HE MCS 11 (1024-QAM, coding rate 5/6) with a single spatial stream
+  std::map<uint32_t, double> dataSubcarriers = {{20, 234}, {40, 468}, {80, 980}, {160, 1960}};
+  if (dataSubcarriers.find (channelWidth) == dataSubcarriers.end ())
+    {
+      NS_FATAL_ERROR ("Unsupported channel width: " << channelWidth);
+    }
+  return dataSubcarriers[channelWidth] * 10 * 5. / 6.;
+}
+
+double
+PpduDuration (double bytes)
+{
+  // SERVICE field and tail bits are added to the PSDU
+  return HE_PREAMBLE + std::ceil ((16 + 8 * bytes + 6) / bitsPerSymbol) * HE_SYMBOL;
+}
+
+double
+LegacyDuration (uint32_t bytes)
+{
+  return LEGACY_PREAMBLE + std::ceil ((16 + 8. * bytes + 6) / LEGACY_BITS_PER_SYMBOL) * LEGACY_SYMBOL;
+}
+
+// Mean duration of a slot of the Bianchi chain (idle, successful or collided)
+double
+SlotTime (const std::vector<StationState> &state)
+{
+  double idle = 1.;
+  double busy = 0.;
+  double success = 0.;
+  double collisionTime = 0.;
+
+  for (auto &st : state)
+    {
+      idle *= 1 - st.tau;
+      success += st.ps;
+      busy += st.ps * st.txopTime;
+      collisionTime = std::max (collisionTime, st.tau > 0 ? st.collisionTime : 0.);
+    }
+
+  return idle * SLOT + busy + std::max (0., 1 - idle - success) * collisionTime;
+}
+
+void
+SolveFixedPoint (const std::vector<StationConfig> &config, std::vector<StationState> &state)
+{
+  uint32_t n = config.size ();
+  double aifs = SIFS + DEFAULT_AIFSN * SLOT;
+
+  for (uint32_t i = 0; i < n; i++)
+    {
+      if (state[i].tau <= 0)
+        {
+          state[i].tau = 2. / (config[i].cwMin + 2.);
+        }
+    }
+
+  for (int iter = 0; iter < 1000; iter++)
+    {
+      double idle = 1.;
+      for (auto &st : state)
+        {
+          idle *= 1 - st.tau;
+        }
+
+      // Durations of transmissions with the current aggregation
+      for (uint32_t i = 0; i < n; i++)
+        {
+          StationState &st = state[i];
+          double psduBytes = st.mpdus * mpduLength;
+          double response = st.mpdus > 1 ? LegacyDuration (32) : LegacyDuration (14);
+          double rtsCts = psduBytes > config[i].rtsThreshold ? LegacyDuration (20) + SIFS + LegacyDuration (14) + SIFS : 0.;
+
+          st.p = 1 - idle / (1 - st.tau);
+          st.ps = st.tau * (1 - st.p);
+          st.txopTime = rtsCts + st.bursts * (PpduDuration (psduBytes) + SIFS + response) + (st.bursts - 1) * SIFS
+                        + aifs + params.extraOverhead;
+          st.collisionTime = (rtsCts > 0 ? LegacyDuration (20) + SIFS + SLOT + LegacyDuration (14)
+                                          : PpduDuration (psduBytes) + SIFS + SLOT + response)
+                             + aifs + params.extraOverhead;
+        }
+
+      double slotTime = SlotTime (state);
+      double maxChange = 0.;
+
+      for (uint32_t i = 0; i < n; i++)
+        {
+          StationState &st = state[i];
+          const StationConfig &cfg = config[i];
+
+          // Attempts and backoff slots per frame over the backoff stages. A larger AIFSN than the
+          // reference one is approximated by extra idle slots before every attempt.
+          double attempts = 0.;
+          double slots = 0.;
+          double stageProb = 1.;
+          double cw = cfg.cwMin;
+          for (uint32_t stage = 0; stage < FRAME_RETRY_LIMIT; stage++)
+            {
+              attempts += stageProb;
+              slots += stageProb * (cw / 2. + 1 + std::max (0., (double) cfg.aifsn - DEFAULT_AIFSN));
+              stageProb *= st.p;
+              cw = std::min (2 * (cw + 1) - 1, (double) cfg.cwMax);
+            }
+          double tauSat = attempts / slots;
+
+          // Maximum aggregation allowed by the A-MPDU size and the calibrated A-MPDU length
+          double maxMpdus = std::max (1., std::floor ((double) cfg.ampduSize / mpduLength));
+          if (cfg.ampduSize > 0 && params.ampduLength > 0)
+            {
+              maxMpdus = std::min (maxMpdus, params.ampduLength);
+            }
+          double maxBursts = 1.;
+          if (cfg.txopLimit > 0)
+            {
+              double ppdu = PpduDuration (maxMpdus * mpduLength) + SIFS + LegacyDuration (32) + SIFS;
+              maxBursts = std::max (1., std::floor (cfg.txopLimit * 1e-6 / ppdu));
+            }
+
+          // A station is backlogged if it cannot serve its load with full aggregation. Otherwise it
+          // sends what arrived since the last access, or contends only for part of the slots.
+          st.accessRate = tauSat * (1 - st.p) / slotTime;
+          st.capacity = st.accessRate * maxMpdus * maxBursts;
+          double perAccess = cfg.offeredLoad / st.accessRate;
+          double q = 1.;
+          double mpdus = maxMpdus;
+          double bursts = maxBursts;
+          if (perAccess < maxMpdus * maxBursts)
+            {
+              bursts = std::max (1., std::ceil (perAccess / maxMpdus));
+              mpdus = std::max (1., perAccess / bursts);
+              q = std::min (1., perAccess);
+            }
+
+          maxChange = std::max ({maxChange, std::fabs (q * tauSat - st.tau),
+                                 std::fabs (mpdus - st.mpdus) / mpdus, std::fabs (bursts - st.bursts) / bursts});
+          st.tau = 0.5 * st.tau + 0.5 * q * tauSat;
+          st.mpdus = 0.5 * st.mpdus + 0.5 * mpdus;
+          st.bursts = 0.5 * st.bursts + 0.5 * bursts;
+        }
+
+      if (maxChange < 1e-9)
+        {
+          break;
+        }
+    }
+
+  // Per-station rates of the solution
+  double idle = 1.;
+  for (auto &st : state)
+    {
+      idle *= 1 - st.tau;
+    }
+  for (auto &st : state)
+    {
+      st.p = 1 - idle / (1 - st.tau);
+      st.ps = st.tau * (1 - st.p);
+      st.pf = st.tau * st.p;
+    }
+  double slotTime = SlotTime (state);
+
+  for (uint32_t i = 0; i < n; i++)
+    {
+      StationState &st = state[i];
+      double successes = st.ps / slotTime;
+      double retryLoss = std::pow (st.p, FRAME_RETRY_LIMIT);
+
+      st.delivered = std::min (successes * st.mpdus * st.bursts, config[i].offeredLoad * (1 - retryLoss));
+      st.retried = st.pf / slotTime * st.mpdus;
+      st.dropped = std::max (0., config[i].offeredLoad - st.delivered);
+
+      // Access delay of the head of the queue and waiting in the queue (full queue when backlogged,
+      // M/D/1 waiting time otherwise)
+      st.serviceTime = st.accessRate > 0 ? 1 / st.accessRate : 0.;
+      double rho = st.capacity > 0 ? config[i].offeredLoad / st.capacity : 1.;
+      if (rho >= 1)
+        {
+          st.queueDelay = st.delivered > 0 ? queueSize / st.delivered : 0.;
+        }
+      else
+        {
+          st.queueDelay = rho / (1 - rho) * st.serviceTime / 2;
+        }
+    }
+}
+
+double
+SampleCount (double mean)
+{
+  if (!useNoise || mean <= 0)
+    {
+      return std::max (0., mean);
+    }
+
+  // Normal approximation of the number of events in a window
+  return std::max (0., std::round (mean + std::sqrt (mean) * noise->GetValue ()));
+}
+
+void
+SampleWindow (double duration)
+{
+  SolveFixedPoint (stationConfig, stationState);
+
+  for (uint32_t i = 0; i < stationState.size (); i++)
+    {
+      StationState &st = stationState[i];
+      double delivered = SampleCount (st.delivered * duration);
+
+      windowRxBytes[i] = delivered * payloadSize;
+      windowCollisions[i] = SampleCount (st.retried * duration);
+      windowLost[i] = SampleCount (st.dropped * duration);
+      windowOffered[i] = stationConfig[i].offeredLoad * duration;
+
+      if (simulationPhase)
+        {
+          totalRxBytes[i] += windowRxBytes[i];
+          totalLost[i] += windowLost[i];
+          totalOffered[i] += windowOffered[i];
+          totalDelivered[i] += delivered;
+          totalDelaySum[i] += delivered * (st.serviceTime + st.queueDelay);
+        }
+
+      csvLogOutput << now - fuzzTime << "," << i << "," << stationConfig[i].cwMin << "," << st.tau << ","
+                   << st.p << "," << 8 * windowRxBytes[i] / (1e6 * duration) << ","
+                   << windowCollisions[i] << "," << windowLost[i] << std::endl;
+    }
+}
+
+// Samples the entries of the running schedule one after another, the window observations are the sums
+void
+SampleSchedule (double duration, int cheaterNumber)
+{
+  uint32_t n = stationState.size ();
+  std::vector<double> rxBytes (n, 0.), collisions (n, 0.), lost (n, 0.), offered (n, 0.);
+
+  scheduleObserved = 0;
+  for (int e = 0; e < scheduleLen && duration > 0; e++)
+    {
+      // The last period may be cut short by the stop time
+      double entryDuration = std::min (scheduleDuration[e], duration);
+      duration -= entryDuration;
+
+      for (int i = 1; i <= cheaterNumber; i++)
+        {
+          SetNetworkConfigurationCheater (scheduleCw[e][i-1], i);
+        }
+      SampleWindow (entryDuration);
+
+      for (uint32_t i = 0; i < n; i++)
+        {
+          rxBytes[i] += windowRxBytes[i];
+          collisions[i] += windowCollisions[i];
+          lost[i] += windowLost[i];
+          offered[i] += windowOffered[i];
+        }
+      for (int i = 0; i < cheaterNumber; i++)
+        {
+          scheduleTx[e][i] = windowRxBytes[i];
+          scheduleLost[e][i] = windowLost[i];
+          scheduleThroughput[e][i] = 8 * windowRxBytes[i] / (1e6 * entryDuration);
+          scheduleCollisions[e][i] = windowCollisions[i];
+        }
+      scheduleObserved = e + 1;
+    }
+
+  windowRxBytes = rxBytes;
+  windowCollisions = collisions;
+  windowLost = lost;
+  windowOffered = offered;
+}
+
+void
+UpdateRollingMetrics (double duration)
+{
+  double jainN = 0.;
+  double jainD = 0.;
+  for (uint32_t i = 0; i < windowRxBytes.size (); i++)
+    {
+      double throughput = 8 * windowRxBytes[i] / (1e6 * duration);
+      double delivered = windowRxBytes[i] / payloadSize;
+
+      rollingThroughput[i].Add (throughput);
+      rollingCollisionRatio[i].Add (windowCollisions[i] + delivered > 0 ? windowCollisions[i] / (windowCollisions[i] + delivered) : 0.);
+      rollingPlr[i].Add (windowOffered[i] > 0 ? std::min (windowLost[i] / windowOffered[i], 1.) : 0.);
+      ewmaFairness.Update (i, rollingThroughput[i].GetEwma ());
+      windowFairness.Update (i, rollingThroughput[i].GetWindowMean ());
+
+      jainN += throughput;
+      jainD += throughput * throughput;
+    }
+  stepFairness = jainD > 0 ? jainN * jainN / (windowRxBytes.size () * jainD) : 1.;
+}
+
+// Samples the window that ends now and exchanges it with the agents, returns false at the stop time
+bool
+ExecuteAction (std::string agentName, uint32_t nWifi, int cheaterNumber)
+{
+  // The window before the first action is the fuzz period, which the packet-level scenario discards
+  double windowStart = std::max (fuzzTime, now - periodLength);
+  if (now > windowStart && scheduleLen > 0)
+    {
+      SampleSchedule (now - windowStart, cheaterNumber);
+    }
+  else if (now > windowStart)
+    {
+      SampleWindow (now - windowStart);
+    }
+  if (now > windowStart)
+    {
+      UpdateRollingMetrics (now - windowStart);
+    }
+
+  if (simulationPhase && now >= stopTime)
+    {
+      return false;
+    }
+
+  bool end_warmup = false;
+
+  if (useMabAgent)
+    {
+      double duration = std::max (now - windowStart, periodLength);
+
+      auto env = m_env->EnvSetterCond ();
+      env->fairness = stepFairness;
+      env->fairness_ewma = ewmaFairness.Get ();
+      env->fairness_window = windowFairness.Get ();
+      env->latency = 0;
+      env->plr = 0;
+      for (int i = 0; i < cheaterNumber; i++)
+        {
+          StationState &st = stationState[i];
+          env->lost_list[i] = windowLost[i];
+          env->tx_list[i] = windowRxBytes[i];
+          env->throughput[i] = 8 * windowRxBytes[i] / (1e6 * duration);
+          env->collisions[i] = windowCollisions[i];
+          env->latency_p50[i] = st.serviceTime - st.queueDelay * std::log (1 - 0.5);
+          env->latency_p95[i] = st.serviceTime - st.queueDelay * std::log (1 - 0.95);
+          env->latency_p99[i] = st.serviceTime - st.queueDelay * std::log (1 - 0.99);
+          env->latency_p999[i] = st.serviceTime - st.queueDelay * std::log (1 - 0.999);
+          env->throughput_ewma[i] = rollingThroughput[i].GetEwma ();
+          env->throughput_window[i] = rollingThroughput[i].GetWindowMean ();
+          env->collision_ratio_ewma[i] = rollingCollisionRatio[i].GetEwma ();
+          env->collision_ratio_window[i] = rollingCollisionRatio[i].GetWindowMean ();
+          env->plr_ewma[i] = rollingPlr[i].GetEwma ();
+          env->plr_window[i] = rollingPlr[i].GetWindowMean ();
+
+          // Little's law for the backlogs; the model does not separate the retry losses from the queue overflows
+          env->qdisc_backlog[i] = std::min ((double) queueSize, st.delivered * st.queueDelay);
+          env->qdisc_sojourn[i] = st.queueDelay;
+          env->qdisc_drops[i] = windowLost[i];
+          env->mac_backlog[i] = st.delivered * st.serviceTime;
+          env->mac_sojourn[i] = st.serviceTime;
+          env->mac_drops[i] = 0;
+        }
+      env->schedule_len = scheduleObserved;
+      for (int e = 0; e < scheduleObserved; e++)
+        {
+          for (int i = 0; i < cheaterNumber; i++)
+            {
+              env->schedule_tx[e][i] = scheduleTx[e][i];
+              env->schedule_lost[e][i] = scheduleLost[e][i];
+              env->schedule_throughput[e][i] = scheduleThroughput[e][i];
+              env->schedule_collisions[e][i] = scheduleCollisions[e][i];
+            }
+        }
+      scheduleObserved = 0;
+      env->time = now - fuzzTime;
+      m_env->SetCompleted ();
+
+      auto act = m_env->ActionGetterCond ();
+      end_warmup = act->end_warmup;
+
+      // A schedule replaces the single CW of the agents for the next period
+      scheduleLen = std::min (std::max (act->schedule_len, 0), MAX_SCHEDULE);
+      periodLength = scheduleLen > 0 ? 0. : interactionTime;
+      for (int e = 0; e < scheduleLen; e++)
+        {
+          if (act->schedule_duration[e] <= 0.)
+            {
+              NS_FATAL_ERROR ("Schedule entry " << e << " has non-positive duration " << act->schedule_duration[e]);
+            }
+          scheduleDuration[e] = act->schedule_duration[e];
+          std::copy (act->schedule_cw[e], act->schedule_cw[e] + cheaterNumber, scheduleCw[e]);
+          periodLength += scheduleDuration[e];
+        }
+
+      m_env->GetCompleted ();
+      for (int i = 1; i <= cheaterNumber; i++)
+        {
+          if (actionCw && scheduleLen == 0)
+            {
+              SetNetworkConfigurationCheater (act->cw[i-1], i);
+            }
+          SetEdcaConfigurationCheater (actionAifsn ? act->aifsn[i-1] : -1,
+                                       actionTxop ? act->txop_limit[i-1] : -1,
+                                       actionAmpdu ? act->ampdu_size[i-1] : -1,
+                                       actionRts ? act->rts_threshold[i-1] : -1, i);
+        }
+    }
+  else
+    {
+      end_warmup = true;
+    }
+
+  // End warmup period and define simulation stop time
+  if (end_warmup && !simulationPhase)
+    {
+      simulationPhase = true;
+      stopTime = now + simulationTime;
+      warmupEndTime = now - fuzzTime;
+      std::cout << "Warmup period finished after " << warmupEndTime << " s" << std::endl;
+    }
+
+  now = simulationPhase ? std::min (now + periodLength, stopTime) : now + periodLength;
+  return true;
+}
+
+void
+SetNetworkConfigurationCheater (int cw_idx, int cheaterNum)
+{
+  if (cw_idx >= 0)
+    {
+      stationConfig[cheaterNum - 1].cwMin = pow (2, cw_idx);
+    }
+}
+
+void
+SetEdcaConfigurationCheater (int aifsn, int txopLimit, int ampduSize, int rtsThreshold, int cheaterNum)
+{
+  StationConfig &cfg = stationConfig[cheaterNum - 1];
+
+  if (aifsn >= 0)
+    {
+      cfg.aifsn = aifsn;
+    }
+  if (txopLimit >= 0)
+    {
+      cfg.txopLimit = txopLimit;
+    }
+  if (ampduSize >= 0)
+    {
+      cfg.ampduSize = ampduSize;
+    }
+  if (rtsThreshold >= 0)
+    {
+      cfg.rtsThreshold = rtsThreshold;
+    }
+}
+
+void
+ParseActionDims (std::string actionDims)
+{
+  std::string dims[16];
+  int n = 0;
+  splitString (actionDims, ',', dims, n);
+
+  actionCw = actionAifsn = actionTxop = actionAmpdu = actionRts = false;
+  for (int i = 0; i < n; i++)
+    {
+      if (dims[i] == "cw")
+        {
+          actionCw = true;
+        }
+      else if (dims[i] == "aifsn")
+        {
+          actionAifsn = true;
+        }
+      else if (dims[i] == "txop")
+        {
+          actionTxop = true;
+        }
+      else if (dims[i] == "ampdu")
+        {
+          actionAmpdu = true;
+        }
+      else if (dims[i] == "rts")
+        {
+          actionRts = true;
+        }
+      else
+        {
+          NS_FATAL_ERROR ("Unknown action dimension: " << dims[i]);
+        }
+    }
+}
+
+bool
+LoadParams (std::string paramsPath)
+{
+  std::ifstream paramsFile (paramsPath);
+  if (!paramsFile.is_open ())
+    {
+      return false;
+    }
+
+  std::string name;
+  double value;
+  while (paramsFile >> name >> value)
+    {
+      if (name == "ampduLength")
+        {
+          params.ampduLength = value;
+        }
+      else if (name == "extraOverhead")
+        {
+          params.extraOverhead = value;
+        }
+    }
+  return true;
+}
+
+/*
+ * Grid search of the model parameters minimizing the mean squared relative error of the
+ * network throughput. The reference CSV has the columns of the scenario_mgr_multi_agent
+ * results (several result files can be concatenated, repeated headers are skipped) and
+ * needs at least nWifi and throughput. Optional columns: cw (CWmin of all stations,
+ * default 15) and dataRate (Mb/s per station). The scenario_mgr_multi_agent results have
+ * no cw column, so they are fitted as default-CW references: use runs without --cw, or add
+ * the column by hand. Runs of other agents than wifi change the CW and are skipped.
+ */
+void
+Calibrate (std::string calibrationPath, std::string paramsPath, uint32_t packetSize,
+           double defaultDataRate)
+{
+  struct Reference
+  {
+    uint32_t nWifi;
+    uint32_t cwMin;
+    double dataRate;
+    double throughput;
+  };
+
+  std::ifstream referenceFile (calibrationPath);
+  if (!referenceFile.is_open ())
+    {
+      NS_FATAL_ERROR ("Cannot open the calibration file: " << calibrationPath);
+    }
+
+  std::string headerLine;
+  std::getline (referenceFile, headerLine);
+  std::string header[64];
+  int nColumns = 0;
+  splitString (headerLine, ',', header, nColumns);
+
+  std::map<std::string, int> column;
+  for (int i = 0; i < nColumns; i++)
+    {
+      column[header[i]] = i;
+    }
+  if (column.count ("nWifi") == 0 || column.count ("throughput") == 0)
+    {
+      NS_FATAL_ERROR ("The calibration file needs the nWifi and throughput columns");
+    }
+
+  std::vector<Reference> references;
+  uint32_t skipped = 0;
+  std::string line;
+  while (std::getline (referenceFile, line))
+    {
+      if (line.empty () || line == headerLine)
+        {
+          continue;
+        }
+
+      std::string values[64];
+      int n = 0;
+      splitString (line, ',', values, n);
+
+      if (column.count ("agent") && values[column["agent"]] != "wifi")
+        {
+          skipped++;
+          continue;
+        }
+
+      Reference ref;
+      ref.nWifi = std::stoi (values[column["nWifi"]]);
+      ref.throughput = std::stod (values[column["throughput"]]);
+      ref.cwMin = column.count ("cw") ? std::stoi (values[column["cw"]]) : DEFAULT_CW_MIN;
+      ref.dataRate = column.count ("dataRate") ? std::stod (values[column["dataRate"]]) : defaultDataRate;
+      references.push_back (ref);
+    }
+
+  if (references.empty ())
+    {
+      NS_FATAL_ERROR ("No reference results in: " << calibrationPath);
+    }
+
+  std::cout << "Calibrating the model against " << references.size () << " reference runs ("
+            << skipped << " runs of agents skipped)..." << std::endl;
+
+  double maxMpdus = std::floor ((double) MAX_AMPDU_SIZE / mpduLength);
+  SurrogateParams best;
+  double bestError = -1.;
+
+  for (double ampduLength = 1; ampduLength <= maxMpdus; ampduLength++)
+    {
+      for (double overhead = 0.; overhead <= 300e-6; overhead += 5e-6)
+        {
+          params.ampduLength = ampduLength;
+          params.extraOverhead = overhead;
+
+          double error = 0.;
+          for (auto &ref : references)
+            {
+              StationConfig cfg;
+              cfg.cwMin = ref.cwMin;
+              cfg.offeredLoad = ref.dataRate * 1e6 / (8. * packetSize);
+
+              std::vector<StationConfig> config (ref.nWifi, cfg);
+              std::vector<StationState> state (ref.nWifi);
+              SolveFixedPoint (config, state);
+
+              double throughput = 0.;
+              for (auto &st : state)
+                {
+                  throughput += 8 * st.delivered * packetSize / 1e6;
+                }
+
+              double relative = (throughput - ref.throughput) / ref.throughput;
+              error += relative * relative / references.size ();
+            }
+
+          if (bestError < 0 || error < bestError)
+            {
+              bestError = error;
+              best = params;
+            }
+        }
+    }
+
+  std::ofstream paramsFile (paramsPath);
+  paramsFile << "ampduLength " << best.ampduLength << std::endl
+             << "extraOverhead " << best.extraOverhead << std::endl;
+
+  std::cout << "Fitted A-MPDU length: " << best.ampduLength << std::endl
+            << "Fitted extra overhead: " << best.extraOverhead * 1e6 << " us" << std::endl
+            << "RMS relative throughput error: " << std::sqrt (bestError) << std::endl
+            << "Model parameters saved to: " << paramsPath << std::endl;
+}
@@ -0,0 +1,150 @@
+#ifndef TELEMETRY_SERVER_H
+#define TELEMETRY_SERVER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ns3/abort.h"
+
+/*
+ * Live telemetry of a running simulation, served as HTTP/1.0 over a Unix-domain socket
+ * (e.g. curl --unix-socket telemetry.sock http://localhost/).
+ *
+ * The simulation thread builds each snapshot in a back buffer and swaps it with the front
+ * buffer the server thread reads. The swap only try-locks: if the server is copying the
+ * front buffer at that moment the snapshot is dropped, so the simulation never waits.
+ */
+class TelemetryServer
+{
+public:
+  ~TelemetryServer ()
+  {
+    Stop ();
+  }
+
+  void
+  Start (std::string path)
+  {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    NS_ABORT_MSG_IF (path.size () >= sizeof (address.sun_path), "Telemetry socket path too long: " << path);
+    path.copy (address.sun_path, path.size ());
+
+    unlink (path.c_str ());
+    m_socket = socket (AF_UNIX, SOCK_STREAM, 0);
+    NS_ABORT_MSG_IF (m_socket < 0 || bind (m_socket, (sockaddr *) &address, sizeof (address)) < 0
+                     || listen (m_socket, 8) < 0, "Cannot open telemetry socket " << path);
+
+    m_path = path;
+    m_front = "{}";
+    m_stop = false;
+    m_thread = std::thread (&TelemetryServer::Serve, this);
+  }
+
+  void
+  Stop ()
+  {
+    if (!m_thread.joinable ())
+      {
+        return;
+      }
+
+    m_stop = true;
+    m_thread.join ();
+    close (m_socket);
+    unlink (m_path.c_str ());
+  }
+
+  bool
+  IsRunning () const
+  {
+    return m_thread.joinable ();
+  }
+
+  // Buffer the next snapshot is written to by the simulation thread
+  std::string &
+  GetBackBuffer ()
+  {
+    return m_back;
+  }
+
+  // Make the back buffer the served snapshot, returns false if it was dropped
+  bool
+  Publish ()
+  {
+    std::unique_lock<std::mutex> lock (m_mutex, std::try_to_lock);
+    if (!lock.owns_lock ())
+      {
+        return false;
+      }
+
+    m_front.swap (m_back);
+    return true;
+  }
+
+private:
+  void
+  Serve ()
+  {
+    pollfd listening = {m_socket, POLLIN, 0};
+    while (!m_stop)
+      {
+        // Wake up regularly to notice Stop
+        if (poll (&listening, 1, 100) <= 0)
+          {
+            continue;
+          }
+
+        int client = accept (m_socket, nullptr, nullptr);
+        if (client < 0)
+          {
+            continue;
+          }
+
+        // The request itself is not parsed, every request gets the latest snapshot
+        char request[1024];
+        pollfd reading = {client, POLLIN, 0};
+        if (poll (&reading, 1, 100) > 0)
+          {
+            [[maybe_unused]] ssize_t received = recv (client, request, sizeof (request), 0);
+          }
+
+        std::string body;
+        {
+          std::lock_guard<std::mutex> lock (m_mutex);
+          body = m_front;
+        }
+
+        std::string response = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+                               + std::to_string (body.size ()) + "\r\nConnection: close\r\n\r\n" + body;
+        for (size_t sent = 0; sent < response.size ();)
+          {
+            ssize_t n = send (client, response.data () + sent, response.size () - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+              {
+                break;
+              }
+            sent += n;
+          }
+        close (client);
+      }
+  }
+
+  std::string m_path;
+  int m_socket = -1;
+  std::thread m_thread;
+  std::atomic<bool> m_stop {false};
+
+  std::mutex m_mutex;
+  std::string m_front;
+  std::string m_back;
+};
+
+#endif /* TELEMETRY_SERVER_H */
@@ -0,0 +1,96 @@
+#ifndef TRANSITION_DATASET_H
+#define TRANSITION_DATASET_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "ns3/abort.h"
+
+/*
+ * Binary replay dataset of (observation, action, next observation) transitions, one record per
+ * agent and interaction. The file is a DatasetHeader followed by fixed-size little-endian
+ * records, read by python/envs/dataset.py.
+ */
+
+// Observation of an agent over one interaction window
+#define OBS_SIZE 8
+enum ObservationField
+{
+  OBS_THROUGHPUT,   // Mb/s
+  OBS_RX_BYTES,
+  OBS_LOST,         // packets
+  OBS_COLLISIONS,   // retransmitted MPDUs
+  OBS_LATENCY_P50,  // s
+  OBS_LATENCY_P95,
+  OBS_LATENCY_P99,
+  OBS_LATENCY_P999
+};
+
+const char DATASET_MAGIC[4] = {'C', 'W', 'T', 'R'};
+const uint32_t DATASET_VERSION = 1;
+
+struct DatasetHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t obsSize;
+  uint32_t recordSize;
+} __attribute__ ((packed));
+
+struct TransitionRecord
+{
+  uint32_t run;       // RngRun of the simulation
+  uint32_t step;      // interaction index
+  uint16_t agent;     // station index of the agent
+  uint16_t action;    // CW index, CW = 2 ^ action
+  float time;         // simulated time of the action since the fuzz period (s)
+  float obs[OBS_SIZE];
+  float nextObs[OBS_SIZE];
+} __attribute__ ((packed));
+
+class TransitionWriter
+{
+public:
+  void
+  Open (std::string path)
+  {
+    m_file.open (path, std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF (!m_file, "Cannot open dataset file " << path);
+
+    DatasetHeader header = {{DATASET_MAGIC[0], DATASET_MAGIC[1], DATASET_MAGIC[2], DATASET_MAGIC[3]},
+                            DATASET_VERSION, OBS_SIZE, sizeof (TransitionRecord)};
+    m_file.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  }
+
+  bool
+  IsOpen () const
+  {
+    return m_file.is_open ();
+  }
+
+  void
+  Write (const TransitionRecord &record)
+  {
+    m_file.write (reinterpret_cast<const char *> (&record), sizeof (record));
+    m_records++;
+  }
+
+  uint64_t
+  GetRecords () const
+  {
+    return m_records;
+  }
+
+  void
+  Close ()
+  {
+    m_file.close ();
+  }
+
+private:
+  std::ofstream m_file;
+  uint64_t m_records = 0;
+};
+
+#endif /* TRANSITION_DATASET_H */
@@ -0,0 +1,158 @@
+from functools import partial
+
+import gymnasium as gym
+import jax
+import jax.numpy as jnp
+from chex import dataclass, Array, PRNGKey, Scalar
+
+from reinforced_lib.agents import AgentState, BaseAgent
+
+
+@dataclass
+class GaussianProcessUCBState(AgentState):
+    """
+    Discounted number of pulls and sum of rewards of every arm, and the prior covariance of the arms.
+    """
+
+    n: Array
+    s: Array
+    kernel: Array
+
+
+class GaussianProcessUCB(BaseAgent):
+    """
+    Bandit modelling the reward as a smooth function of the arm index with a Gaussian process.
+
+    The arms are CW indices (CW = 2 ^ arm), so the squared exponential kernel over the arm index
+    is a kernel over log2(CW). A reward observed for one arm updates the posterior of its
+    neighbours, so the agent stops pulling whole regions of absurd CWs after a few samples
+    instead of trying every arm. The next arm maximizes the upper confidence bound
+    ``mean + beta * std`` of the posterior. The statistics are discounted by ``decay`` at every
+    update, as the reward of a CW changes with the actions of the other stations.
+
+    Parameters
+    ----------
+    n_arms : int
+        Number of CW indices.
+    beta : float
+        Weight of the posterior standard deviation in the upper confidence bound.
+    lengthscale : float
+        Distance (in arms, factors of 2 of the CW) over which the rewards are correlated.
+    noise : float
+        Standard deviation of a single reward around the mean reward of the arm.
+    signal_std : float
+        Prior standard deviation of the mean rewards.
+    prior_mean : float
+        Prior mean reward of every arm.
+    decay : float
+        Discount of the past observations at every update (1 - stationary rewards).
+    """
+
+    def __init__(
+            self,
+            n_arms: int,
+            beta: Scalar = 2.0,
+            lengthscale: Scalar = 2.0,
+            noise: Scalar = 0.1,
+            signal_std: Scalar = 0.5,
+            prior_mean: Scalar = 0.5,
+            decay: Scalar = 0.99
+    ) -> None:
+        assert beta >= 0
+        assert lengthscale > 0
+        assert noise > 0
+        assert 0 < decay <= 1
+
+        self.n_arms = n_arms
+
+        self.init = jax.jit(partial(self.init, n_arms=n_arms, lengthscale=lengthscale, signal_std=signal_std))
+        self.update = jax.jit(partial(self.update, decay=decay))
+        self.sample = jax.jit(partial(self.sample, beta=beta, noise=noise, prior_mean=prior_mean))
+
+    @staticmethod
+    def parameter_space() -> gym.spaces.Dict:
+        return gym.spaces.Dict({
+            'n_arms': gym.spaces.Box(1, jnp.inf, (1,), int),
+            'beta': gym.spaces.Box(0.0, jnp.inf, (1,)),
+            'lengthscale': gym.spaces.Box(0.0, jnp.inf, (1,)),
+            'noise': gym.spaces.Box(0.0, jnp.inf, (1,)),
+            'signal_std': gym.spaces.Box(0.0, jnp.inf, (1,)),
+            'prior_mean': gym.spaces.Box(-jnp.inf, jnp.inf, (1,)),
+            'decay': gym.spaces.Box(0.0, 1.0, (1,))
+        })
+
+    @property
+    def update_observation_space(self) -> gym.spaces.Dict:
+        return gym.spaces.Dict({
+            'action': gym.spaces.Discrete(self.n_arms),
+            'reward': gym.spaces.Box(-jnp.inf, jnp.inf, (1,))
+        })
+
+    @property
+    def sample_observation_space(self) -> gym.spaces.Dict:
+        return gym.spaces.Dict({})
+
+    @property
+    def action_space(self) -> gym.spaces.Discrete:
+        return gym.spaces.Discrete(self.n_arms)
+
+    @staticmethod
+    def init(key: PRNGKey, n_arms: int, lengthscale: Scalar, signal_std: Scalar) -> GaussianProcessUCBState:
+        arms = jnp.arange(n_arms, dtype=float)
+        kernel = signal_std ** 2 * jnp.exp(-(arms[:, None] - arms[None, :]) ** 2 / (2 * lengthscale ** 2))
+
+        return GaussianProcessUCBState(
+            n=jnp.zeros(n_arms),
+            s=jnp.zeros(n_arms),
+            kernel=kernel
+        )
+
+    @staticmethod
+    def update(
+            state: GaussianProcessUCBState,
+            key: PRNGKey,
+            action: int,
+            reward: Scalar,
+            decay: Scalar
+    ) -> GaussianProcessUCBState:
+        return GaussianProcessUCBState(
+            n=(decay * state.n).at[action].add(1.0),
+            s=(decay * state.s).at[action].add(reward),
+            kernel=state.kernel
+        )
+
+    @staticmethod
+    def posterior(state: GaussianProcessUCBState, noise: Scalar, prior_mean: Scalar) -> tuple[Array, Array]:
+        """
+        Posterior mean and variance of the mean rewards. The observations of an arm are
+        summarised by their mean with precision n / noise^2, arms without pulls have zero
+        precision, so the posterior needs no inverse of the kernel:
+        ``cov = K - K R (I + R K R)^-1 R K`` with ``R = sqrt(n) / noise``.
+        """
+
+        root = jnp.sqrt(state.n) / noise
+        observed = jnp.where(state.n > 0, state.s / jnp.maximum(state.n, 1e-12), prior_mean) - prior_mean
+
+        b = jnp.eye(state.n.shape[0]) + root[:, None] * state.kernel * root[None, :]
+        cholesky = jnp.linalg.cholesky(b)
+        w = root[:, None] * state.kernel
+        v = jax.scipy.linalg.cho_solve((cholesky, True), w)
+
+        mean = prior_mean + w.T @ jax.scipy.linalg.cho_solve((cholesky, True), root * observed)
+        var = jnp.diag(state.kernel) - jnp.sum(w * v, axis=0)
+        return mean, jnp.maximum(var, 0.0)
+
+    @staticmethod
+    def sample(
+            state: GaussianProcessUCBState,
+            key: PRNGKey,
+            beta: Scalar,
+            noise: Scalar,
+            prior_mean: Scalar
+    ) -> int:
+        mean, var = GaussianProcessUCB.posterior(state, noise, prior_mean)
+        ucb = mean + beta * jnp.sqrt(var)
+
+        # ties (e.g. before the first pull) are broken at random
+        ucb = ucb + 1e-9 * jax.random.uniform(key, ucb.shape)
+        return jnp.argmax(ucb)
@@ -0,0 +1,89 @@
+import os
+os.environ['JAX_ENABLE_X64'] = 'True'
+
+import argparse
+
+from mldr.envs.sweep import run_experiment, run_sequential, write_results
+
+
+def run_benchmark(run):
+    run_dir = os.path.join(run['outDir'], f'nBss{run["nBss"]}_ranks{run["ranks"]}_{run["repeat"]}')
+    results = run_experiment(run_dir, run['nWifi'], {
+        'bssCsvPath': os.path.join(run_dir, 'bss.csv'),
+        'fuzzTime': run['fuzzTime'],
+        'mempoolKey': run['mempoolKey'],
+        'mpiRanks': run['ranks'],
+        'nBss': run['nBss'],
+        'ns3Path': run['ns3Path'],
+        'scenario': 'scenario_mgr_multi_bss',
+        'seed': run['seed'] + run['repeat'],
+        'simulationTime': run['simulationTime']
+    })
+
+    return {**run, 'wallTime': float(results['wallTime']), 'events': float(results['events']),
+            'throughput': float(results['throughput'])}
+
+
+if __name__ == '__main__':
+    args = argparse.ArgumentParser()
+
+    args.add_argument('--fuzzTime', type=float, default=1.0)
+    args.add_argument('--mempoolKeyBase', type=int, default=7000)
+    args.add_argument('--nBss', type=int, nargs='+', default=[8, 16])
+    args.add_argument('--ns3Path', type=str, default='')
+    args.add_argument('--nWifi', type=int, default=10)
+    args.add_argument('--outDir', type=str, default='mpi_benchmark')
+    args.add_argument('--ranks', type=int, nargs='+', default=[1, 2, 4, 8])
+    args.add_argument('--repeats', type=int, default=3)
+    args.add_argument('--seed', type=int, default=4)
+    args.add_argument('--simulationTime', type=float, default=5.0)
+
+    args = vars(args.parse_args())
+
+    out_dir = os.path.abspath(args['outDir'])
+    os.makedirs(out_dir, exist_ok=True)
+
+    runs = []
+    for n_bss in args['nBss']:
+        for repeat in range(args['repeats']):
+            for ranks in args['ranks']:
+                if ranks > n_bss:
+                    continue
+                runs.append({
+                    'fuzzTime': args['fuzzTime'],
+                    'mempoolKey': args['mempoolKeyBase'] + len(runs),
+                    'nBss': n_bss,
+                    'nWifi': args['nWifi'],
+                    'ns3Path': args['ns3Path'],
+                    'outDir': out_dir,
+                    'ranks': ranks,
+                    'repeat': repeat,
+                    'seed': args['seed'],
+                    'simulationTime': args['simulationTime']
+                })
+
+    # every run already uses as many cores as it has ranks
+    results = []
+    for result in run_sequential(run_benchmark, runs):
+        print(f'nBss {result["nBss"]}, {result["ranks"]} ranks: {result["wallTime"]:.2f} s, '
+              f'{result["events"] / result["wallTime"]:.0f} events/s')
+        results.append(result)
+
+    results_path = os.path.join(out_dir, 'benchmark.csv')
+    write_results(results_path, results, ['nBss', 'ranks', 'repeat', 'wallTime', 'events', 'throughput'])
+
+    # speedup of the mean wall time against a single rank
+    print('Speedup:')
+    for n_bss in args['nBss']:
+        mean_time = {}
+        for ranks in args['ranks']:
+            times = [r['wallTime'] for r in results if r['nBss'] == n_bss and r['ranks'] == ranks]
+            if times:
+                mean_time[ranks] = sum(times) / len(times)
+
+        base = mean_time.get(1)
+        if base is None:
+            continue
+        print(f'- nBss {n_bss}: {", ".join(f"{r} ranks {base / t:.2f}x ({t:.2f} s)" for r, t in mean_time.items())}')
+
+    print(f'Benchmark results saved to: {results_path}')
@@ -0,0 +1,82 @@
+import os
+os.environ['JAX_ENABLE_X64'] = 'True'
+
+import argparse
+
+from mldr.envs.sweep import run_experiment, run_sequential, write_results
+
+
+def run_benchmark(run):
+    run_dir = os.path.join(run['outDir'], f'nWifi{run["nWifi"]}_{run["scheduler"]}_{run["repeat"]}')
+    results = run_experiment(run_dir, run['nWifi'], {
+        'fuzzTime': run['fuzzTime'],
+        'mempoolKey': run['mempoolKey'],
+        'ns3Path': run['ns3Path'],
+        'profilePath': os.path.join(run_dir, 'profile.csv') if run['profile'] else '',
+        'scheduler': run['scheduler'],
+        'seed': run['seed'] + run['repeat'],
+        'simulationTime': run['simulationTime']
+    })
+
+    wall_time = float(results['wallTime'])
+    events = int(results['events'])
+    return {**run, 'wallTime': wall_time, 'events': events, 'eventsPerSecond': events / wall_time}
+
+
+if __name__ == '__main__':
+    args = argparse.ArgumentParser()
+
+    args.add_argument('--fuzzTime', type=float, default=1.0)
+    args.add_argument('--mempoolKeyBase', type=int, default=6000)
+    args.add_argument('--ns3Path', type=str, default='')
+    args.add_argument('--nWifi', type=int, nargs='+', default=[10, 25, 50, 100, 200, 500])
+    args.add_argument('--outDir', type=str, default='scheduler_benchmark')
+    args.add_argument('--profile', action=argparse.BooleanOptionalAction, default=False)
+    args.add_argument('--repeats', type=int, default=3)
+    args.add_argument('--schedulers', type=str, nargs='+', default=['Map', 'Heap', 'Calendar', 'PriorityQueue'])
+    args.add_argument('--seed', type=int, default=4)
+    args.add_argument('--simulationTime', type=float, default=5.0)
+
+    args = vars(args.parse_args())
+
+    out_dir = os.path.abspath(args['outDir'])
+    os.makedirs(out_dir, exist_ok=True)
+
+    runs = []
+    for n_wifi in args['nWifi']:
+        for repeat in range(args['repeats']):
+            for scheduler in args['schedulers']:
+                runs.append({
+                    'fuzzTime': args['fuzzTime'],
+                    'mempoolKey': args['mempoolKeyBase'] + len(runs),
+                    'nWifi': n_wifi,
+                    'ns3Path': args['ns3Path'],
+                    'outDir': out_dir,
+                    'profile': args['profile'],
+                    'repeat': repeat,
+                    'scheduler': scheduler,
+                    'seed': args['seed'],
+                    'simulationTime': args['simulationTime']
+                })
+
+    results = []
+    for result in run_sequential(run_benchmark, runs):
+        print(f'nWifi {result["nWifi"]}, {result["scheduler"]}: {result["wallTime"]:.2f} s, '
+              f'{result["eventsPerSecond"]:.0f} events/s')
+        results.append(result)
+
+    results_path = os.path.join(out_dir, 'benchmark.csv')
+    write_results(results_path, results, ['nWifi', 'scheduler', 'repeat', 'wallTime', 'events', 'eventsPerSecond'])
+
+    # the scheduler with the lowest mean wall time at each scale
+    print('Best scheduler:')
+    for n_wifi in args['nWifi']:
+        mean_time = {}
+        for scheduler in args['schedulers']:
+            times = [r['wallTime'] for r in results if r['nWifi'] == n_wifi and r['scheduler'] == scheduler]
+            mean_time[scheduler] = sum(times) / len(times)
+
+        best = min(mean_time, key=mean_time.get)
+        print(f'- nWifi {n_wifi}: {best} ({", ".join(f"{s} {t:.2f} s" for s, t in mean_time.items())})')
+
+    print(f'Benchmark results saved to: {results_path}')
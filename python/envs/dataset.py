@@ -0,0 +1,54 @@
+import os
+
+import numpy as np
+
+
+# Must match ns3_files/transition-dataset.h
+DATASET_MAGIC = b'CWTR'
+DATASET_VERSION = 1
+OBS_FIELDS = ['throughput', 'rxBytes', 'lost', 'collisions', 'latencyP50', 'latencyP95', 'latencyP99', 'latencyP999']
+
+HEADER_DTYPE = np.dtype([
+    ('magic', 'S4'),
+    ('version', '<u4'),
+    ('obsSize', '<u4'),
+    ('recordSize', '<u4')
+])
+
+
+def record_dtype(obs_size=len(OBS_FIELDS)):
+    return np.dtype([
+        ('run', '<u4'),
+        ('step', '<u4'),
+        ('agent', '<u2'),
+        ('action', '<u2'),
+        ('time', '<f4'),
+        ('obs', '<f4', (obs_size,)),
+        ('nextObs', '<f4', (obs_size,))
+    ])
+
+
+def load_transitions(path, mmap=True):
+    header = np.fromfile(path, dtype=HEADER_DTYPE, count=1)
+    if len(header) == 0 or header[0]['magic'] != DATASET_MAGIC:
+        raise ValueError(f'{path} is not a transition dataset')
+
+    header = header[0]
+    if header['version'] != DATASET_VERSION:
+        raise ValueError(f'{path} has dataset version {header["version"]}, expected {DATASET_VERSION}')
+
+    dtype = record_dtype(int(header['obsSize']))
+    if header['recordSize'] != dtype.itemsize:
+        raise ValueError(f'{path} has {header["recordSize"]} B records, expected {dtype.itemsize} B')
+
+    # a run that was killed may leave a partial record at the end
+    n_records = (os.path.getsize(path) - HEADER_DTYPE.itemsize) // dtype.itemsize
+    if n_records == 0:
+        return np.empty(0, dtype=dtype)
+    if mmap:
+        return np.memmap(path, dtype=dtype, mode='r', offset=HEADER_DTYPE.itemsize, shape=(n_records,))
+    return np.fromfile(path, dtype=dtype, count=n_records, offset=HEADER_DTYPE.itemsize)
+
+
+def load_dataset(paths):
+    return np.concatenate([load_transitions(path, mmap=False) for path in paths])
@@ -0,0 +1,76 @@
+import argparse
+import os
+import time
+
+from mldr.envs.sweep import prepare_binary, run_binary, run_parallel, write_results
+
+
+def run_evaluation(run):
+    # the frozen policy is executed by the scenario, so the binary is run directly without the agents
+    run_dir = os.path.join(run['outDir'], f'cheaters{run["cheaterNumber"]}_{run["seed"]}')
+    return run_binary(run, run_dir, {
+        'agentName': run['agentName'],
+        'cheaterNumber': run['cheaterNumber'],
+        'policyPath': run['policyPath']
+    })
+
+
+if __name__ == '__main__':
+    args = argparse.ArgumentParser()
+
+    args.add_argument('--agentName', type=str, default='policy')
+    args.add_argument('--binary', type=str, default='')
+    args.add_argument('--cheaterNumbers', type=int, nargs='+', default=[1, 2, 5, 10])
+    args.add_argument('--ns3Path', type=str, default='')
+    args.add_argument('--outDir', type=str, default='evaluation')
+    args.add_argument('--policyPath', type=str, required=True)
+    args.add_argument('--runs', type=int, default=10)
+    args.add_argument('--scenario', type=str, default='scenario_mgr_multi_agent')
+    args.add_argument('--seed', type=int, default=200)
+    args.add_argument('--workers', type=int, default=os.cpu_count())
+
+    # scenario args
+    args.add_argument('--dataRate', type=int, default=100)
+    args.add_argument('--fuzzTime', type=float, default=5.0)
+    args.add_argument('--interactionTime', type=float, default=0.5)
+    args.add_argument('--nWifi', type=int, default=10)
+    args.add_argument('--resultCache', type=str, default='')
+    args.add_argument('--simulationTime', type=float, default=40.0)
+    args.add_argument('--trafficMode', type=str, default='onoff')
+
+    args = vars(args.parse_args())
+
+    binary, env = prepare_binary(args['ns3Path'], args['binary'], args['scenario'])
+    scenario_args = {key: args[key] for key in [
+        'dataRate', 'fuzzTime', 'interactionTime', 'nWifi', 'resultCache', 'simulationTime', 'trafficMode'
+    ]}
+
+    out_dir = os.path.abspath(args['outDir'])
+    runs = []
+    for cheater_number in args['cheaterNumbers']:
+        for i in range(args['runs']):
+            runs.append({
+                'agentName': args['agentName'],
+                'binary': binary,
+                'cheaterNumber': cheater_number,
+                'env': env,
+                'outDir': out_dir,
+                'policyPath': os.path.abspath(args['policyPath']),
+                'scenarioArgs': scenario_args,
+                'seed': args['seed'] + i
+            })
+
+    # the results CSVs of all runs are gathered in a single file
+    start = time.time()
+    results = []
+    for result in run_parallel(run_evaluation, runs, args['workers']):
+        results.append(result)
+        print(f'cheaterNumber {result["cheaterNumber"]}, seed {result["seed"]}: '
+              f'throughput {float(result["throughput"]):.2f} Mb/s, fairness {float(result["fairness"]):.3f} '
+              f'({len(results)} / {len(runs)} runs, {time.time() - start:.0f} s)')
+
+    results_path = os.path.join(out_dir, 'evaluation.csv')
+    results.sort(key=lambda r: (int(r['cheaterNumber']), int(r['seed'])))
+    write_results(results_path, results, list(results[0].keys()))
+
+    print(f'Evaluation results saved to: {results_path}')
@@ -0,0 +1,162 @@
+import argparse
+import fcntl
+import mmap
+import os
+import struct
+import time
+
+import numpy as np
+
+
+# Must match ns3_files/event-ring.h
+RING_MAGIC = b'CWEV'
+RING_VERSION = 1
+MAX_CONSUMERS = 4
+WRITE_OFFSET = 64
+OVERFLOW_OFFSET = 128
+CONSUMERS_OFFSET = 192
+CONSUMER_SIZE = 64
+HEADER_SIZE = 448
+
+EVENT_TYPES = ['tx', 'retry', 'drop', 'rx']
+
+RECORD_DTYPE = np.dtype([
+    ('time', '<f8'),
+    ('station', '<u4'),
+    ('type', 'u1'),
+    ('mcs', 'u1'),
+    ('cw', '<u2'),
+    ('size', '<u4'),
+    ('reserved', '<u4')
+])
+
+
+class EventRing:
+    """
+    Consumer of the frame event ring of scenario_mgr_multi_agent (--eventRingName).
+
+    The consumer registers its read index in a free slot of the ring header, the simulation
+    drops records instead of overwriting the ones it has not read yet. The slot is released
+    by ``close`` (and by the simulation if the process exits without it).
+    """
+
+    def __init__(self, name, timeout=10.0):
+        path = os.path.join('/dev/shm', name.lstrip('/'))
+
+        # the ring is created by the simulation, wait for it to start
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                self.file = open(path, 'r+b')
+                size = os.fstat(self.file.fileno()).st_size
+                if size >= HEADER_SIZE:
+                    self.memory = mmap.mmap(self.file.fileno(), size)
+                    if self.memory[:4] == RING_MAGIC:
+                        break
+                    self.memory.close()
+                self.file.close()
+            except FileNotFoundError:
+                pass
+            if time.monotonic() > deadline:
+                raise TimeoutError(f'Event ring {name} not found')
+            time.sleep(0.05)
+
+        version, record_size, self.capacity = struct.unpack_from('<III', self.memory, 4)
+        if version != RING_VERSION:
+            raise ValueError(f'Event ring {name} has version {version}, expected {RING_VERSION}')
+        if record_size != RECORD_DTYPE.itemsize:
+            raise ValueError(f'Event ring {name} has {record_size} B records, expected {RECORD_DTYPE.itemsize} B')
+
+        self.header = np.frombuffer(self.memory, dtype='<u8', count=HEADER_SIZE // 8)
+        self.records = np.frombuffer(self.memory, dtype=RECORD_DTYPE, count=self.capacity, offset=HEADER_SIZE)
+
+        # the lock only serialises consumers claiming slots, the simulation never takes it
+        fcntl.flock(self.file, fcntl.LOCK_EX)
+        try:
+            for slot in range(MAX_CONSUMERS):
+                offset = CONSUMERS_OFFSET + slot * CONSUMER_SIZE
+                if struct.unpack_from('<i', self.memory, offset + 8)[0] == 0:
+                    break
+            else:
+                raise RuntimeError(f'Event ring {name} already has {MAX_CONSUMERS} consumers')
+
+            # an all-ones read index keeps the slot out of the producer's minimum until it is set
+            self.header[offset // 8] = np.iinfo(np.uint64).max
+            struct.pack_into('<i', self.memory, offset + 8, os.getpid())
+            self.slot_offset = offset
+        finally:
+            fcntl.flock(self.file, fcntl.LOCK_UN)
+
+        # The write index is read after the slot is active (the unlock is a full barrier), so the
+        # producer has not yet reused any ring slot of a record from this index on
+        self.read_index = int(self.header[WRITE_OFFSET // 8])
+        self.header[offset // 8] = self.read_index
+
+    @property
+    def overflow(self):
+        """Records the simulation dropped because a consumer was a full ring behind."""
+        return int(self.header[OVERFLOW_OFFSET // 8])
+
+    def read(self, max_records=None):
+        """Returns a copy of the records pushed since the last call."""
+
+        write_index = int(self.header[WRITE_OFFSET // 8])
+        if max_records is not None:
+            write_index = min(write_index, self.read_index + max_records)
+
+        first = self.read_index % self.capacity
+        last = write_index % self.capacity
+        if write_index - self.read_index == 0:
+            records = self.records[:0].copy()
+        elif first < last:
+            records = self.records[first:last].copy()
+        else:
+            records = np.concatenate([self.records[first:], self.records[:last]])
+
+        # the records are copied before the read index lets the simulation overwrite them
+        self.read_index = write_index
+        self.header[self.slot_offset // 8] = write_index
+        return records
+
+    def close(self):
+        if self.memory.closed:
+            return
+        struct.pack_into('<i', self.memory, self.slot_offset + 8, 0)
+        del self.header, self.records
+        self.memory.close()
+        self.file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+if __name__ == '__main__':
+    args = argparse.ArgumentParser()
+
+    args.add_argument('--interval', type=float, default=1.0)
+    args.add_argument('--name', type=str, required=True)
+    args.add_argument('--timeout', type=float, default=10.0)
+
+    args = vars(args.parse_args())
+
+    # prints the events of every interval until the simulation removes the ring
+    with EventRing(args['name'], args['timeout']) as ring:
+        path = os.path.join('/dev/shm', args['name'].lstrip('/'))
+        total = 0
+
+        running = True
+        while running:
+            time.sleep(args['interval'])
+            running = os.path.exists(path)
+            records = ring.read()
+            total += len(records)
+
+            counts = np.bincount(records['type'], minlength=len(EVENT_TYPES))
+            sim_time = records['time'][-1] if len(records) else float('nan')
+            print(f'{sim_time:.3f} s: ' + ', '.join(f'{t} {c}' for t, c in zip(EVENT_TYPES, counts))
+                  + f' (overflow {ring.overflow})')
+
+        print(f'{total} records read')
@@ -0,0 +1,66 @@
+import argparse
+import os
+import time
+
+from mldr.envs.dataset import load_transitions
+from mldr.envs.sweep import prepare_binary, run_binary, run_parallel
+
+
+def run_generation(run):
+    # the dataset mode needs no agents' process, so the scenario binary is run directly
+    run_dir = os.path.join(run['outDir'], f'{run["policy"]}_{run["seed"]}')
+    dataset_path = os.path.join(run_dir, 'dataset.bin')
+    run_binary(run, run_dir, {'behaviourPolicy': run['policy'], 'datasetPath': dataset_path})
+
+    return dataset_path, len(load_transitions(dataset_path))
+
+
+if __name__ == '__main__':
+    args = argparse.ArgumentParser()
+
+    args.add_argument('--binary', type=str, default='')
+    args.add_argument('--ns3Path', type=str, default='')
+    args.add_argument('--outDir', type=str, default='dataset')
+    args.add_argument('--policies', type=str, nargs='+', default=['random', 'epsilon', 'sweep'])
+    args.add_argument('--runs', type=int, default=10)
+    args.add_argument('--scenario', type=str, default='scenario_mgr_multi_agent')
+    args.add_argument('--seed', type=int, default=100)
+    args.add_argument('--workers', type=int, default=os.cpu_count())
+
+    # scenario args
+    args.add_argument('--cheaterNumber', type=int, default=5)
+    args.add_argument('--fuzzTime', type=float, default=1.0)
+    args.add_argument('--interactionTime', type=float, default=0.1)
+    args.add_argument('--nWifi', type=int, default=10)
+    args.add_argument('--policyArms', type=int, default=11)
+    args.add_argument('--simulationTime', type=float, default=20.0)
+    args.add_argument('--trafficMode', type=str, default='saturation')
+
+    args = vars(args.parse_args())
+
+    binary, env = prepare_binary(args['ns3Path'], args['binary'], args['scenario'])
+    scenario_args = {key: args[key] for key in [
+        'cheaterNumber', 'fuzzTime', 'interactionTime', 'nWifi', 'policyArms', 'simulationTime', 'trafficMode'
+    ]}
+
+    out_dir = os.path.abspath(args['outDir'])
+    runs = []
+    for policy in args['policies']:
+        for i in range(args['runs']):
+            runs.append({
+                'binary': binary,
+                'env': env,
+                'outDir': out_dir,
+                'policy': policy,
+                'scenarioArgs': scenario_args,
+                'seed': args['seed'] + i
+            })
+
+    start = time.time()
+    total = 0
+    for dataset_path, n_transitions in run_parallel(run_generation, runs, args['workers']):
+        total += n_transitions
+        elapsed = time.time() - start
+        print(f'{dataset_path}: {n_transitions} transitions ({total} total, {3600 * total / elapsed:.0f} per hour)')
+
+    print(f'Datasets saved to: {out_dir}')
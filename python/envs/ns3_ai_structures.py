@@ -0,0 +1,83 @@
+from ctypes import *
+
+
+# Must match MAX_AGENTS and MAX_SCHEDULE in ns3_files/ns3-ai-structures.h
+MAX_AGENTS = 10
+MAX_SCHEDULE = 8
+
+
+class Env(Structure):
+    _pack_ = 1
+    _fields_ = [
+        ('fairness', c_double),
+        ('latency', c_double),
+        ('plr', c_double),
+        ('time', c_double),
+        ('tx_list', c_double * MAX_AGENTS),
+        ('lost_list', c_double * MAX_AGENTS),
+        ('throughput', c_double * MAX_AGENTS),
+        ('collisions', c_double * MAX_AGENTS),
+        ('latency_p50', c_double * MAX_AGENTS),
+        ('latency_p95', c_double * MAX_AGENTS),
+        ('latency_p99', c_double * MAX_AGENTS),
+        ('latency_p999', c_double * MAX_AGENTS),
+        ('schedule_len', c_int),
+        ('schedule_tx', (c_double * MAX_AGENTS) * MAX_SCHEDULE),
+        ('schedule_lost', (c_double * MAX_AGENTS) * MAX_SCHEDULE),
+        ('schedule_throughput', (c_double * MAX_AGENTS) * MAX_SCHEDULE),
+        ('schedule_collisions', (c_double * MAX_AGENTS) * MAX_SCHEDULE),
+        ('fairness_ewma', c_double),
+        ('fairness_window', c_double),
+        ('throughput_ewma', c_double * MAX_AGENTS),
+        ('throughput_window', c_double * MAX_AGENTS),
+        ('collision_ratio_ewma', c_double * MAX_AGENTS),
+        ('collision_ratio_window', c_double * MAX_AGENTS),
+        ('plr_ewma', c_double * MAX_AGENTS),
+        ('plr_window', c_double * MAX_AGENTS),
+        ('qdisc_backlog', c_double * MAX_AGENTS),
+        ('qdisc_sojourn', c_double * MAX_AGENTS),
+        ('qdisc_drops', c_double * MAX_AGENTS),
+        ('mac_backlog', c_double * MAX_AGENTS),
+        ('mac_sojourn', c_double * MAX_AGENTS),  # enqueue to ack (or expiry), retries included
+        ('mac_drops', c_double * MAX_AGENTS)
+    ]
+
+
+class Act(Structure):
+    _pack_ = 1
+    _fields_ = [
+        ('end_warmup', c_bool),
+        ('cw', c_int * MAX_AGENTS),
+        ('aifsn', c_int * MAX_AGENTS),
+        ('txop_limit', c_int * MAX_AGENTS),
+        ('ampdu_size', c_int * MAX_AGENTS),
+        ('rts_threshold', c_int * MAX_AGENTS),
+        ('agent_time', c_double),
+        ('schedule_len', c_int),
+        ('schedule_duration', c_double * MAX_SCHEDULE),
+        ('schedule_cw', (c_int * MAX_AGENTS) * MAX_SCHEDULE)
+    ]
+
+
+# Structures of the single agent scenario (ns3_files/scenario_mgr.cc)
+class SingleAgentEnv(Structure):
+    _pack_ = 1
+    _fields_ = [
+        ('fairness', c_double),
+        ('latency', c_double),
+        ('plr', c_double),
+        ('throughput', c_double),
+        ('time', c_double),
+        ('latency_p50', c_double),
+        ('latency_p95', c_double),
+        ('latency_p99', c_double),
+        ('latency_p999', c_double)
+    ]
+
+
+class SingleAgentAct(Structure):
+    _pack_ = 1
+    _fields_ = [
+        ('cw', c_int),
+        ('end_warmup', c_bool)
+    ]
@@ -2,7 +2,14 @@ import os
 os.environ['JAX_ENABLE_X64'] = 'True'
 
 import argparse
+import dataclasses
+import hashlib
+import inspect
+import json
+import subprocess
+import time
 from collections import deque
+from types import SimpleNamespace
 
 from tqdm import tqdm
 import jax
@@ -13,15 +20,35 @@ from reinforced_lib.agents.mab import *
 from reinforced_lib.exts import BasicMab
 from reinforced_lib.logs import *
 
-from mldr.envs.ns3_ai_structures import Env, Act
+from mldr.agents.gaussian_process_ucb import GaussianProcessUCB
+from mldr.envs.ns3_ai_structures import Env, Act, MAX_AGENTS, MAX_SCHEDULE
 
 
 MEMBLOCK_KEY = 2333
-MEM_SIZE = 512
+MEM_SIZE = 8192
 
 N_CW = 24
-N_RTS_CTS = 2
-N_AMPDU = 2
+
+# values of the optional action dimensions (see --actionDims)
+AIFSN_VALUES = [2, 3, 5, 7]
+TXOP_LIMITS = [0, 2528, 5088]           # us
+AMPDU_SIZES = [0, 16383, 65535]         # B
+RTS_THRESHOLDS = [0, 1500, 65535]       # B
+
+ACTION_VALUES = {
+    'cw': list(range(N_CW)),
+    'aifsn': AIFSN_VALUES,
+    'txop': TXOP_LIMITS,
+    'ampdu': AMPDU_SIZES,
+    'rts': RTS_THRESHOLDS
+}
+ACTION_FIELDS = {
+    'cw': 'cw',
+    'aifsn': 'aifsn',
+    'txop': 'txop_limit',
+    'ampdu': 'ampdu_size',
+    'rts': 'rts_threshold'
+}
 
 ACTION_HISTORY_LEN = 20
 ACTION_PROB_THRESHOLD = 0.9
@@ -40,25 +67,261 @@ AGENT_ARGS = {
         'beta': 0.2,
         'mu': 1.0,
         'lam': 0.0,
+    },
+    'GaussianProcessUCB': {
+        'beta': 2.0,
+        'lengthscale': 2.0,
+        'noise': 0.1,
+        'signal_std': 0.5,
+        'prior_mean': 0.5,
+        'decay': 0.99
     }
 }
 
 
+def load_agent_state(path, expected, n_agents, seed, mapping, agent_params, logger_params):
+    # the metadata tells whether the snapshot fits the current agent and action space
+    with open(path + '.json') as file:
+        meta = json.load(file)
+
+    for key, value in expected.items():
+        if meta[key] != value:
+            raise ValueError(f'Agent state {path} has {key}={meta[key]}, expected {value}')
+
+    rlib = RLib.load(
+        path,
+        agent_params=agent_params,
+        logger_types=CsvLogger,
+        logger_params=logger_params,
+        logger_sources=('reward', SourceType.METRIC)
+    )
+
+    # agents keep their index, snapshot agents beyond n_agents are dropped and the missing
+    # ones start either fresh ('index') or from the snapshot agent i % n_saved ('cycle')
+    n_saved = meta['nAgents']
+    agent_ids = list(range(min(n_agents, n_saved)))
+
+    for i in range(n_saved, n_agents):
+        if mapping == 'cycle':
+            # RLib has no public way to copy an agent, the copy gets its own random key
+            container = rlib._agent_containers[i % n_saved]
+            rlib._agent_containers.append(dataclasses.replace(container, key=jax.random.PRNGKey(seed + i)))
+            agent_ids.append(len(rlib._agent_containers) - 1)
+        else:
+            agent_ids.append(rlib.init(seed + i))
+
+    print(f'Agent state loaded from: {path} ({n_saved} saved agents, {n_agents} agents, mapping: {mapping})')
+    return rlib, agent_ids
+
+
+def save_agent_state(rlib, agent_ids, path, meta):
+    saved_path = rlib.save(agent_ids=agent_ids, path=path)
+
+    with open(saved_path + '.json', 'w') as file:
+        json.dump({**meta, 'nAgents': len(agent_ids)}, file)
+
+    print(f'Agent state saved to: {saved_path}')
+    return saved_path
+
+
+def convergence_time(history, window, tolerance):
+    # first time from which the moving mean reward of an agent stays within the tolerance
+    # (a fraction) of its final value, NaN if it never settles
+    if len(history) < window:
+        return float('nan')
+
+    times, rewards = map(np.asarray, zip(*history))
+    means = np.convolve(rewards, np.ones(window) / window, mode='valid')
+    outside = np.nonzero(np.abs(means - means[-1]) > tolerance * abs(means[-1]))[0]
+
+    first = outside[-1] + 1 if len(outside) else 0
+    if first >= len(means):
+        return float('nan')
+    return float(times[first + window - 1])
+
+
+def write_convergence(csv_path, reward_history, window, tolerance):
+    csv_dir, csv_name = os.path.split(csv_path)
+    path = os.path.join(csv_dir, f'convergence_{csv_name}')
+
+    times = [convergence_time(history, window, tolerance) for history in reward_history]
+    with open(path, 'w') as file:
+        file.write('agent,convergenceTime,steps,finalReward\n')
+        for i, (history, t) in enumerate(zip(reward_history, times)):
+            final = np.mean([r for _, r in history[-window:]]) if history else float('nan')
+            file.write(f'{i},{t},{len(history)},{final}\n')
+
+    print(f'Mean convergence time: {np.nanmean(times) if not np.isnan(times).all() else float("nan"):.2f} s, saved to: {path}')
+
+
+def value_estimates(agent, state, agent_params):
+    # mean reward of every arm estimated by the agent (NaN - arm never pulled), None if its state has none
+    if agent == 'GaussianProcessUCB':
+        values = GaussianProcessUCB.posterior(state, agent_params['noise'], agent_params['prior_mean'])[0]
+    elif hasattr(state, 'Q'):
+        values = state.Q
+    elif hasattr(state, 'R') and hasattr(state, 'N'):
+        values = state.R / np.maximum(state.N, 1e-12)
+    elif hasattr(state, 'mu'):
+        values = state.mu
+    else:
+        return None
+
+    values = np.asarray(values, dtype=float)
+    if hasattr(state, 'N') and np.any(np.asarray(state.N) > 0):
+        values = np.where(np.asarray(state.N) > 0, values, np.nan)
+    return values
+
+
+def write_policy(path, rlib, agent_ids, agent, agent_params, action_log, action_dims, action_values, action_shape):
+    # greedy action of every agent, the argmax of its value estimates, with the values of the
+    # Act fields (-1 - not controlled) as read by ns3_files/frozen-policy.h
+    with open(path, 'w') as file:
+        file.write(','.join(['agent', *ACTION_FIELDS]) + '\n')
+        for i, (agent_id, actions) in enumerate(zip(agent_ids, action_log)):
+            values = dict.fromkeys(ACTION_FIELDS, -1)
+            estimates = value_estimates(agent, rlib._agent_containers[agent_id].state, agent_params)
+
+            if estimates is not None:
+                action = int(np.nanargmax(estimates))
+            elif actions:
+                # the action the agent chose most often in its last interactions
+                print(f'Warning: {agent} has no value estimates, agent {i} exports its most frequent recent action')
+                arms, counts = np.unique(actions[-ACTION_HISTORY_LEN:], return_counts=True)
+                action = arms[counts.argmax()]
+            else:
+                action = None
+
+            if action is not None:
+                action_idx = np.unravel_index(action, action_shape)
+                for dim, idx in zip(action_dims, action_idx):
+                    values[dim] = action_values[dim][idx]
+            file.write(','.join(map(str, [i, *values.values()])) + '\n')
+
+    print(f'Policy of {len(action_log)} agents exported to: {path}')
+
+
+def file_digest(path):
+    with open(path, 'rb') as file:
+        return hashlib.sha1(file.read()).hexdigest()
+
+
+def agent_identity(agent, agent_params, n_cw, schedule_len, reward_signal, load_state, args):
+    # everything on the Python side that changes the results, part of the result cache key of the scenario;
+    # the fixed-CW baseline does not depend on the agent settings, so its runs are shared by all comparisons
+    if agent == 'wifi':
+        return 'wifi'
+
+    identity = {
+        'agent': agent,
+        'agentParams': agent_params or AGENT_ARGS.get(agent),
+        'code': file_digest(__file__),
+        'agentCode': file_digest(inspect.getfile(globals()[agent])) if agent in AGENT_ARGS else '',
+        'loadState': file_digest(load_state) if load_state else '',
+        'nCw': n_cw,
+        'rewardSignal': reward_signal,
+        'rewardWeights': [args['massive'], args['throughput'], args['urllc']],
+        'scheduleLen': schedule_len,
+        'warmup': [args['useWarmup'], args['maxWarmup']]
+    }
+    return hashlib.sha1(json.dumps(identity, sort_keys=True).encode()).hexdigest()
+
+
+def schedule_entry(env, entry):
+    # observations of a single schedule entry, with the fields of Env used by the reward function
+    return SimpleNamespace(
+        fairness=env.fairness,
+        latency=env.latency,
+        time=env.time,
+        tx_list=env.schedule_tx[entry],
+        lost_list=env.schedule_lost[entry],
+        throughput=env.schedule_throughput[entry],
+        collisions=env.schedule_collisions[entry]
+    )
+
+
+def run_mpi(ns3_path, scenario, ns3_args, n_ranks, mempool_key, show_output):
+    # the partitioned scenario is started under a local mpirun instead of ./ns3 run,
+    # its rank 0 attaches to the memory pool of the experiment like ./ns3 run would do
+    from mldr.envs.sweep import find_binary
+
+    subprocess.run(['./ns3', 'build', scenario], cwd=ns3_path, check=True, capture_output=not show_output)
+    binary = find_binary(ns3_path, scenario)
+
+    env = dict(os.environ)
+    env['LD_LIBRARY_PATH'] = os.pathsep.join(filter(None, [os.path.join(ns3_path, 'build', 'lib'), env.get('LD_LIBRARY_PATH')]))
+    env['NS_GLOBAL_VALUE'] = f'SharedMemoryKey={mempool_key};SharedMemoryPoolSize={MEM_SIZE};'
+
+    command = ['mpirun', '-np', str(n_ranks), binary, *[f'--{key}={value}' for key, value in ns3_args.items()]]
+    output = None if show_output else subprocess.DEVNULL
+    return subprocess.Popen(command, env=env, stdout=output, stderr=output)
+
+
 def main_uczenie(args):
     # read the arguments
     ns3_path = args.pop('ns3Path')
+    agent_params = args.pop('agentParams', None)
+    n_cw = args.pop('nCw', N_CW)
+    show_output = args.pop('showOutput', True)
+    load_state = args.pop('loadState', '')
+    save_state = args.pop('saveState', '')
+    export_policy = args.pop('exportPolicy', '')
+    state_mapping = args.pop('stateMapping', 'cycle')
+    schedule_len = args.pop('scheduleLen', 0)
+    reward_signal = args.pop('rewardSignal', 'raw')
+    n_bss = args.pop('nBss', 1)
+    convergence_window = args.pop('convergenceWindow', 10)
+    convergence_tolerance = args.pop('convergenceTolerance', 0.05)
+    mpi_ranks = args.pop('mpiRanks', 1)
 
     if args['scenario'] == 'scenario_mgr_multi_agent':
         del args['interPacketInterval']
         del args['mcs']
         del args['thrPath']
         dataRate = min(115, args['dataRate'] * args['nWifi'])
+    elif args['scenario'] == 'scenario_surrogate':
+        for key in ['collisionMatrixPath', 'collisionWindowPath', 'eventRingCapacity', 'eventRingName', 'flowMonitor',
+                    'flowmonPath', 'forceRun', 'infra', 'interPacketInterval', 'interactionTracePath', 'mcs',
+                    'memoryBudget', 'ofdma', 'profilePath', 'resultCache', 'scheduler', 'telemetryPath', 'thrPath',
+                    'trafficMode']:
+            del args[key]
+        dataRate = min(115, args['dataRate'] * args['nWifi'])
+    elif args['scenario'] == 'scenario_mgr_multi_bss':
+        if args['actionDims'] != 'cw' or schedule_len or reward_signal != 'raw':
+            raise ValueError('The multi-BSS scenario supports only the cw action dimension and raw rewards')
+        for key in ['channelWidth', 'collisionMatrixPath', 'collisionWindowPath', 'eventRingCapacity',
+                    'eventRingName', 'flowMonitor', 'flowmonPath', 'forceRun', 'infra', 'interPacketInterval',
+                    'interactionTracePath', 'mcs', 'memoryBudget', 'metricsAlpha', 'metricsWindow', 'ofdma',
+                    'profilePath', 'queueDisc', 'resultCache', 'scheduler', 'telemetryPath', 'thrPath',
+                    'trafficMode']:
+            del args[key]
+        args['nBss'] = n_bss
+        dataRate = min(115, args['dataRate'] * args['nWifi'])
     elif args['scenario'] == 'adhoc':
+        del args['collisionMatrixPath']
+        del args['collisionWindowPath']
+        del args['crnRun']
         del args['dataRate']
+        del args['eventRingCapacity']
+        del args['eventRingName']
+        del args['flowMonitor']
+        del args['forceRun']
+        del args['resultCache']
+        del args['infra']
+        del args['ofdma']
         del args['maxQueueSize']
+        del args['metricsAlpha']
+        del args['metricsWindow']
+        del args['interactionTracePath']
+        del args['memoryBudget']
+        del args['profilePath']
+        del args['queueDisc']
+        del args['scheduler']
+        del args['telemetryPath']
+        del args['trafficMode']
         dataRate = (args['packetSize'] * args['nWifi'] / args['interPacketInterval']) / 1e6
 
-    ns3_path = "/home/student/magisterka/ns-allinone-3.42/ns-3.42"
+    ns3_path = ns3_path or "/home/student/magisterka/ns-allinone-3.42/ns-3.42"
 
     seed = args.pop('seed')
     key = jax.random.PRNGKey(seed)
@@ -70,6 +333,40 @@ def main_uczenie(args):
     ns3_args = args
     ns3_args['RngRun'] = seed
 
+    if scenario == 'scenario_mgr_multi_agent':
+        ns3_args['agentIdentity'] = agent_identity(agent, agent_params, n_cw, schedule_len, reward_signal, load_state, args)
+
+    # the saved agent state and the exported policy are outputs the result cache does not keep
+    if (save_state or export_policy) and args.get('resultCache'):
+        print('Result cache disabled, the agent state or policy is saved')
+        ns3_args['resultCache'] = ''
+
+    # joint action space over the enabled dimensions
+    action_values = dict(ACTION_VALUES, cw=list(range(n_cw)))
+    action_dims = args['actionDims'].split(',')
+    action_shape = tuple(len(action_values[dim]) for dim in action_dims)
+    n_arms = int(np.prod(action_shape))
+
+    # with a schedule every station has one agent (lane) per schedule entry, so that each lane
+    # gets the reward of the entry it chose, lanes of entry k are agents k * cheaterNumber + i
+    if not 0 <= schedule_len <= MAX_SCHEDULE:
+        raise ValueError(f'Schedule length must be between 0 and {MAX_SCHEDULE}')
+    if schedule_len and action_dims != ['cw']:
+        raise ValueError('Action schedules support only the cw action dimension')
+    if schedule_len and reward_signal != 'raw':
+        raise ValueError('Schedule entries are rewarded with the raw per-entry observations')
+    if agent == 'GaussianProcessUCB' and action_dims != ['cw']:
+        raise ValueError('GaussianProcessUCB models the reward over log2(CW), it supports only the cw action dimension')
+    if export_policy and (schedule_len or agent == 'wifi'):
+        raise ValueError('Only the single actions of trained agents can be exported as a policy')
+
+    # agents of the multi-BSS scenario are numbered BSS by BSS
+    n_controlled = args['cheaterNumber'] * (n_bss if scenario == 'scenario_mgr_multi_bss' else 1)
+    if not 0 <= n_controlled <= MAX_AGENTS:
+        raise ValueError(f'At most {MAX_AGENTS} stations can be controlled, got {n_controlled}')
+    n_lanes = max(schedule_len, 1)
+    n_agents = n_controlled * n_lanes
+
     # set up the reward function
     reward_probs = np.asarray([args.pop('massive'), args.pop('throughput'), args.pop('urllc')])
 
@@ -83,6 +380,11 @@ def main_uczenie(args):
         else:
             plr = env.lost_list[agent_num]/env.tx_list[agent_num]
             colision_index = (env.collisions[agent_num]) / env.tx_list[agent_num]
+        # the smoothed collision ratio of the simulator instead of the value of the last interaction
+        if reward_signal == 'ewma':
+            colision_index = env.collision_ratio_ewma[agent_num]
+        elif reward_signal == 'window':
+            colision_index = env.collision_ratio_window[agent_num]
         reward = (1 - (colision_index))
         # reward = throughput
         rewards = np.asarray([reward])
@@ -121,18 +423,31 @@ def main_uczenie(args):
     elif agent not in AGENT_ARGS:
         raise ValueError('Invalid agent type')
     else:
-        rlib = RLib(
-            agent_type=globals()[agent],
-            agent_params=AGENT_ARGS[agent],
-            ext_type=BasicMab,
-            ext_params={'n_arms': N_CW},
-            logger_types=CsvLogger,
-            logger_params={'csv_path': f'rlib_{args["csvPath"]}'},
-            logger_sources=('reward', SourceType.METRIC)
-        )
-        agent_id_list = []
-        for i in range(args["cheaterNumber"]):
-            agent_id_list.append(rlib.init(seed+i))
+        csv_dir, csv_name = os.path.split(args['csvPath'])
+        logger_params = {'csv_path': os.path.join(csv_dir, f'rlib_{csv_name}')}
+        state_meta = {'agent': agent, 'actionDims': args['actionDims'], 'nArms': n_arms}
+
+        if load_state:
+            rlib, agent_id_list = load_agent_state(
+                load_state, state_meta, n_agents, seed, state_mapping, agent_params, logger_params
+            )
+        else:
+            rlib = RLib(
+                agent_type=globals()[agent],
+                agent_params=agent_params or AGENT_ARGS[agent],
+                ext_type=BasicMab,
+                ext_params={'n_arms': n_arms},
+                logger_types=CsvLogger,
+                logger_params=logger_params,
+                logger_sources=('reward', SourceType.METRIC)
+            )
+            agent_id_list = []
+            for i in range(n_agents):
+                agent_id_list.append(rlib.init(seed+i))
+
+    # rewards of every agent over time, for the convergence time, and its actions, for the exported policy
+    reward_history = [[] for _ in range(n_agents)]
+    action_log = [[] for _ in range(n_agents)]
 
     # set up the environment
     exp = Experiment(mempool_key, MEM_SIZE, scenario, ns3_path, using_waf=False)
@@ -140,62 +455,127 @@ def main_uczenie(args):
 
     try:
         # run the experiment
-        ns3_process = exp.run(setting=ns3_args, show_output=True)
+        if scenario == 'scenario_mgr_multi_bss':
+            ns3_process = run_mpi(ns3_path, scenario, ns3_args, mpi_ranks, mempool_key, show_output)
+        else:
+            ns3_process = exp.run(setting=ns3_args, show_output=show_output)
 
         while not var.isFinish():
             with var as data:
                 if data is None:
                     break
-                for i in range(args["cheaterNumber"]):
+
+                start = time.perf_counter()
+                for i in range(n_controlled):
                     key, subkey = jax.random.split(key)
-                    reward = normalize_rewards(data.env, i)
-                    action = rlib.sample(reward, agent_id=agent_id_list[i]) #dodac ID
-                    cw, rts_cts, ampdu = np.unravel_index(action, (N_CW, 1, 2))
 
-                    rlib.log(f'cw{i}', cw) #dodac ID
-                    data.act.cw[i] = cw #dodac ID
-                    data.act.end_warmup = end_warmup(cw, data.env.time)
+                    for dim, field in ACTION_FIELDS.items():
+                        getattr(data.act, field)[i] = -1
+
+                    if schedule_len:
+                        # before the first schedule there are no entries, all lanes get the whole window
+                        for k in range(schedule_len):
+                            env = schedule_entry(data.env, k) if k < data.env.schedule_len else data.env
+                            reward = normalize_rewards(env, i)
+                            reward_history[k * n_controlled + i].append((data.env.time, reward))
+                            action = rlib.sample(reward, agent_id=agent_id_list[k * n_controlled + i])
+                            data.act.schedule_cw[k][i] = action_values['cw'][action]
+                            rlib.log(f'cw{i}', action_values['cw'][action])
+                    else:
+                        reward = normalize_rewards(data.env, i)
+                        reward_history[i].append((data.env.time, reward))
+                        action = rlib.sample(reward, agent_id=agent_id_list[i]) #dodac ID
+                        action_log[i].append(int(action))
+                        action_idx = np.unravel_index(action, action_shape)
+
+                        for dim, idx in zip(action_dims, action_idx):
+                            value = action_values[dim][idx]
+                            getattr(data.act, ACTION_FIELDS[dim])[i] = value
+                            rlib.log(f'{dim}{i}', value) #dodac ID
+
+                    data.act.end_warmup = end_warmup(action, data.env.time)
+
+                data.act.schedule_len = schedule_len
+                for k in range(schedule_len):
+                    data.act.schedule_duration[k] = args['interactionTime']
+
+                data.act.agent_time = time.perf_counter() - start
 
         ns3_process.wait()
+
+        if rlib is not None and any(reward_history):
+            write_convergence(args['csvPath'], reward_history, convergence_window, convergence_tolerance)
+
+        if save_state and rlib is not None:
+            save_state = save_agent_state(rlib, agent_id_list, save_state, state_meta)
+
+        if export_policy:
+            write_policy(export_policy, rlib, agent_id_list, agent, agent_params or AGENT_ARGS[agent],
+                         action_log, action_dims, action_values, action_shape)
     finally:
         del exp
         del rlib
 
-if __name__ == '__main__':
-    agent_name = "UCB"
-    thr = 100
-    CHEATER_NUMBER = 10
-
-    WIFI_NUMBER = 10
-
-    # logs_name = f"LOG_MULTI_AGENT_10_cheatersn{CHEATER_NUMBER}_{agent_name}_{thr}.csv"
-    # csvPath_name = f"A_MULTI_AGENT_10_cheatersn{CHEATER_NUMBER}_{agent_name}_{thr}.csv"
+    return save_state
 
+def build_parser(agent_name='UCB', thr=100, wifi_number=10):
     args = argparse.ArgumentParser()
 
     # global settings
     args.add_argument('--mempoolKey', type=int, default=2333)
+    args.add_argument('--mpiRanks', type=int, default=1)
     args.add_argument('--ns3Path', type=str, default='')
     args.add_argument('--scenario', type=str, default='scenario_mgr_multi_agent')
+    args.add_argument('--seed', type=int, default=4)
+
+    # agent state snapshots
+    args.add_argument('--exportPolicy', type=str, default='')
+    args.add_argument('--loadState', type=str, default='')
+    args.add_argument('--saveState', type=str, default='')
+    args.add_argument('--stateMapping', type=str, default='cycle', choices=['cycle', 'index'])
 
     # ns-3 args
+    args.add_argument('--actionDims', type=str, default='cw')
     args.add_argument('--agentName', type=str, default=agent_name)
     args.add_argument('--ampdu', action=argparse.BooleanOptionalAction, default=True)
     args.add_argument('--channelWidth', type=int, default=20)
+    args.add_argument('--cheaterNumber', type=int, default=1)
+    args.add_argument('--collisionMatrixPath', type=str, default='')
+    args.add_argument('--collisionWindowPath', type=str, default='')
+    args.add_argument('--crnRun', type=int, default=-1)
+    args.add_argument('--csvLogPath', type=str, default='logs.csv')
+    args.add_argument('--csvPath', type=str, default='results.csv')
     args.add_argument('--cw', type=int, default=-1)
     args.add_argument('--dataRate', type=int, default=thr)  # TOSIE ZMIENIA
     args.add_argument('--distance', type=float, default=10.0)
+    args.add_argument('--eventRingCapacity', type=int, default=65536)
+    args.add_argument('--eventRingName', type=str, default='')
+    args.add_argument('--flowMonitor', action=argparse.BooleanOptionalAction, default=False)
     args.add_argument('--flowmonPath', type=str, default='flowmon.xml')
+    args.add_argument('--forceRun', action=argparse.BooleanOptionalAction, default=False)
     args.add_argument('--fuzzTime', type=float, default=5.0)
+    args.add_argument('--infra', action=argparse.BooleanOptionalAction, default=False)
     args.add_argument('--interactionTime', type=float, default=0.5)
     args.add_argument('--interPacketInterval', type=float, default=0.5)
+    args.add_argument('--interactionTracePath', type=str, default='')
     args.add_argument('--maxQueueSize', type=int, default=100)
     args.add_argument('--mcs', type=int, default=11)
-    args.add_argument('--nWifi', type=int, default=WIFI_NUMBER)
+    args.add_argument('--metricsAlpha', type=float, default=0.2)
+    args.add_argument('--metricsWindow', type=int, default=10)
+    args.add_argument('--memoryBudget', type=float, default=0.0)
+    args.add_argument('--nBss', type=int, default=1)
+    args.add_argument('--nWifi', type=int, default=wifi_number)
+    args.add_argument('--ofdma', type=str, default='none', choices=['none', 'dl', 'ul'])
     args.add_argument('--packetSize', type=int, default=1500)
+    args.add_argument('--profilePath', type=str, default='')
+    args.add_argument('--queueDisc', type=str, default='fifo', choices=['fifo', 'codel', 'fqcodel'])
+    args.add_argument('--resultCache', type=str, default='')
     args.add_argument('--rtsCts', action=argparse.BooleanOptionalAction, default=False)
+    args.add_argument('--scheduler', type=str, default='Map')
     args.add_argument('--simulationTime', type=float, default=40.0)
+    args.add_argument('--telemetryPath', type=str, default='')
     args.add_argument('--thrPath', type=str, default='thr.txt')
+    args.add_argument('--trafficMode', type=str, default='onoff', choices=['onoff', 'saturation'])
 
     # reward weights
     args.add_argument('--massive', type=float, default=0.0)
@@ -203,21 +583,43 @@ if __name__ == '__main__':
     args.add_argument('--urllc', type=float, default=0.0)
 
     # agent settings
+    args.add_argument('--convergenceTolerance', type=float, default=0.05)
+    args.add_argument('--convergenceWindow', type=int, default=10)
     args.add_argument('--maxWarmup', type=int, default=50.0)
+    args.add_argument('--rewardSignal', type=str, default='raw', choices=['raw', 'ewma', 'window'])
+    args.add_argument('--scheduleLen', type=int, default=0)
     args.add_argument('--useWarmup', action=argparse.BooleanOptionalAction, default=False)
 
+    return args
+
+
+if __name__ == '__main__':
+    agent_name = "UCB"
+    thr = 100
+    CHEATER_NUMBER = 10
+
+    WIFI_NUMBER = 10
+
+    # logs_name = f"LOG_MULTI_AGENT_10_cheatersn{CHEATER_NUMBER}_{agent_name}_{thr}.csv"
+    # csvPath_name = f"A_MULTI_AGENT_10_cheatersn{CHEATER_NUMBER}_{agent_name}_{thr}.csv"
+
+    args = build_parser(agent_name, thr, WIFI_NUMBER)
+
+    # every run of the sweep starts from the agent state saved by the previous one
+    args.add_argument('--warmStartSweep', action=argparse.BooleanOptionalAction, default=False)
+    previous_state = ''
 
     cheaters_list = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]
     for n in cheaters_list:
         logs_name = f"SEED4_COLISION_{WIFI_NUMBER}_cheatersn{n}_{agent_name}_{thr}.csv"
         csvPath_name = f"SEED4_COLISION_{WIFI_NUMBER}_cheatersn{n}_{agent_name}_{thr}.csv"
-        args.add_argument('--cheaterNumber', type=int, default=n)
-
-        args.add_argument('--csvLogPath', type=str, default=logs_name)
-        args.add_argument('--csvPath', type=str, default=csvPath_name)
-
-        args.add_argument('--seed', type=int, default=4)
+        args.set_defaults(cheaterNumber=n, csvLogPath=logs_name, csvPath=csvPath_name)
 
         args_parse = args.parse_args()
         args_vars = vars(args_parse)
-        main_uczenie(args_vars)
\ No newline at end of file
+
+        if args_vars.pop('warmStartSweep'):
+            args_vars['loadState'] = previous_state or args_vars['loadState']
+            args_vars['saveState'] = f"{args_vars['saveState'] or 'agent_state'}_cheatersn{n}"
+
+        previous_state = main_uczenie(args_vars)
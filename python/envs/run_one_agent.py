@@ -13,7 +13,7 @@ from reinforced_lib.agents.mab import *
 from reinforced_lib.exts import BasicMab
 from reinforced_lib.logs import *
 
-from mldr.envs.ns3_ai_structures import Env, Act
+from mldr.envs.ns3_ai_structures import SingleAgentEnv as Env, SingleAgentAct as Act
 
 
 MEMBLOCK_KEY = 2333
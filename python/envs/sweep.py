@@ -0,0 +1,95 @@
+import csv
+import glob
+import multiprocessing
+import os
+import subprocess
+from multiprocessing.pool import ThreadPool
+
+
+DEFAULT_NS3_PATH = "/home/student/magisterka/ns-allinone-3.42/ns-3.42"
+
+
+def find_binary(ns3_path, scenario):
+    # e.g. build/scratch/ns3.42-scenario_mgr_multi_agent-default
+    candidates = glob.glob(os.path.join(ns3_path, 'build', 'scratch', '**', f'ns3*-{scenario}-*'), recursive=True)
+    if not candidates:
+        raise FileNotFoundError(f'No {scenario} binary in {ns3_path}/build, build it first')
+    return max(candidates, key=os.path.getmtime)
+
+
+def prepare_binary(ns3_path, binary, scenario):
+    # builds the scenario unless a binary is given, returns it with the environment it runs in
+    ns3_path = ns3_path or DEFAULT_NS3_PATH
+    if not binary:
+        subprocess.run(['./ns3', 'build', scenario], cwd=ns3_path, check=True)
+        binary = find_binary(ns3_path, scenario)
+
+    env = dict(os.environ)
+    env['LD_LIBRARY_PATH'] = os.pathsep.join(filter(None, [os.path.join(ns3_path, 'build', 'lib'), env.get('LD_LIBRARY_PATH')]))
+    return binary, env
+
+
+def run_binary(run, run_dir, scenario_args):
+    # runs without the agents' process call the scenario binary directly, with the outputs in run_dir
+    os.makedirs(run_dir, exist_ok=True)
+
+    csv_path = os.path.join(run_dir, 'results.csv')
+    command = [
+        run['binary'],
+        f'--RngRun={run["seed"]}',
+        f'--csvPath={csv_path}',
+        f'--csvLogPath={os.path.join(run_dir, "logs.csv")}',
+        f'--detectorPath={os.path.join(run_dir, "detector.csv")}',
+        f'--flowmonPath={os.path.join(run_dir, "flowmon.xml")}',
+        '--pcapName=',
+        '--printPositions=false',
+        *[f'--{key}={value}' for key, value in {**run['scenarioArgs'], **scenario_args}.items()]
+    ]
+
+    with open(os.path.join(run_dir, 'output.txt'), 'w') as output:
+        subprocess.run(command, stdout=output, stderr=subprocess.STDOUT, env=run['env'], check=True)
+
+    with open(csv_path) as file:
+        return next(csv.DictReader(file))
+
+
+def run_experiment(run_dir, wifi_number, settings):
+    # runs main_uczenie with the default settings of run.py and the outputs in run_dir,
+    # imported here, so that every run gets a fresh process with its own ns3-ai state
+    from mldr.envs.run import build_parser, main_uczenie
+
+    os.makedirs(run_dir, exist_ok=True)
+
+    args = vars(build_parser('wifi', wifi_number=wifi_number).parse_args([]))
+    args.update({
+        'csvLogPath': os.path.join(run_dir, 'logs.csv'),
+        'csvPath': os.path.join(run_dir, 'results.csv'),
+        'flowmonPath': os.path.join(run_dir, 'flowmon.xml'),
+        'showOutput': False,
+        **settings
+    })
+
+    main_uczenie(args)
+
+    with open(args['csvPath']) as file:
+        return next(csv.DictReader(file))
+
+
+def run_parallel(function, runs, workers):
+    # results in the order the runs finish, the runs are separate processes so threads suffice
+    with ThreadPool(workers) as pool:
+        yield from pool.imap_unordered(function, runs)
+
+
+def run_sequential(function, runs):
+    # results in the order of the runs, executed one at a time in a fresh process each,
+    # so that they do not compete for the CPU
+    with multiprocessing.get_context('spawn').Pool(1, maxtasksperchild=1) as pool:
+        yield from pool.imap(function, runs)
+
+
+def write_results(path, results, fields):
+    with open(path, 'w', newline='') as file:
+        writer = csv.DictWriter(file, fieldnames=fields, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows(results)
@@ -0,0 +1,215 @@
+import os
+os.environ['JAX_ENABLE_X64'] = 'True'
+
+import argparse
+import csv
+import math
+import multiprocessing
+import time
+
+import numpy as np
+
+from mldr.envs.sweep import run_experiment
+
+
+# ('log', low, high), ('uniform', low, high) or ('choice', [values])
+SEARCH_SPACES = {
+    'EGreedy': {
+        'e': ('log', 1e-3, 0.3),
+        'optimistic_start': ('uniform', 0.0, 2.0)
+    },
+    'UCB': {
+        'c': ('log', 1e-3, 1.0)
+    },
+    'NormalThompsonSampling': {
+        'alpha': ('log', 0.1, 20.0),
+        'beta': ('log', 0.05, 5.0),
+        'mu': ('uniform', 0.0, 2.0),
+        'lam': ('uniform', 0.0, 1.0)
+    },
+    'GaussianProcessUCB': {
+        'beta': ('log', 0.1, 5.0),
+        'lengthscale': ('uniform', 0.5, 4.0),
+        'noise': ('log', 0.01, 0.5),
+        'decay': ('uniform', 0.9, 1.0)
+    }
+}
+N_CW_CHOICES = [7, 12, 16, 24]
+
+
+def sample_config(agent, rng, tune_n_cw):
+    params = {}
+
+    for name, (kind, *space) in SEARCH_SPACES[agent].items():
+        if kind == 'log':
+            params[name] = float(np.exp(rng.uniform(np.log(space[0]), np.log(space[1]))))
+        elif kind == 'uniform':
+            params[name] = float(rng.uniform(space[0], space[1]))
+        else:
+            params[name] = space[0][rng.integers(len(space[0]))]
+
+    n_cw = int(rng.choice(N_CW_CHOICES)) if tune_n_cw else None
+    return {'agentParams': params, 'nCw': n_cw}
+
+
+def run_trial(trial):
+    trial_dir = os.path.join(trial['outDir'], f'config{trial["configId"]}_budget{trial["budget"]:g}')
+    settings = {
+        **trial['scenarioArgs'],
+        'agentParams': trial['config']['agentParams'],
+        'mempoolKey': trial['mempoolKey'],
+        'simulationTime': trial['budget']
+    }
+    if trial['config']['nCw'] is not None:
+        settings['nCw'] = trial['config']['nCw']
+
+    start = time.time()
+    results = run_experiment(trial_dir, trial['scenarioArgs']['nWifi'], settings)
+    wall_time = time.time() - start
+
+    return {**trial, 'score': float(results[trial['objective']]), 'wallTime': wall_time}
+
+
+def successive_halving(configs, min_budget, max_budget, eta, pool, trial_args, history):
+    alive = list(configs)
+    budget = min_budget
+
+    while True:
+        trials = []
+        for config_id in alive:
+            trial_args['nextKey'] += 1
+            trials.append({
+                **trial_args['common'],
+                'budget': budget,
+                'config': configs[config_id],
+                'configId': config_id,
+                'mempoolKey': trial_args['nextKey']
+            })
+
+        results = pool.map(run_trial, trials, chunksize=1)
+        history.extend(results)
+
+        sign = -1 if trial_args['common']['minimize'] else 1
+        ranked = sorted(results, key=lambda r: sign * r['score'], reverse=True)
+
+        print(f'Budget {budget:g} s: ' + ', '.join(f'{r["configId"]}={r["score"]:.4f}' for r in ranked))
+
+        if budget >= max_budget or len(alive) == 1:
+            return
+
+        keep = max(1, len(alive) // eta)
+        alive = [r['configId'] for r in ranked[:keep]]
+        budget = min(max_budget, budget * eta)
+
+
+def write_leaderboard(path, configs, history, minimize):
+    rows = {}
+
+    for r in history:
+        row = rows.setdefault(r['configId'], {'budget': 0., 'score': None, 'simTime': 0., 'wallTime': 0., 'trials': 0})
+        row['simTime'] += r['budget']
+        row['wallTime'] += r['wallTime']
+        row['trials'] += 1
+
+        if r['budget'] >= row['budget']:
+            row['budget'] = r['budget']
+            row['score'] = r['score']
+
+    # configurations that reached a larger budget rank first, then by their score at that budget
+    sign = -1 if minimize else 1
+    ranking = sorted(rows.items(), key=lambda item: (item[1]['budget'], sign * item[1]['score']), reverse=True)
+
+    with open(path, 'w', newline='') as file:
+        writer = csv.writer(file)
+        writer.writerow(['rank', 'configId', 'nCw', 'agentParams', 'budget', 'score', 'trials', 'simTime', 'wallTime'])
+
+        for rank, (config_id, row) in enumerate(ranking, 1):
+            config = configs[config_id]
+            writer.writerow([rank, config_id, config['nCw'], config['agentParams'], row['budget'], row['score'],
+                             row['trials'], row['simTime'], row['wallTime']])
+
+    total_sim = sum(r['budget'] for r in history)
+    total_wall = sum(r['wallTime'] for r in history)
+    print(f'Leaderboard saved to: {path}')
+    print(f'Compute spent: {len(history)} runs, {total_sim:g} s simulated, {total_wall:.1f} s of run wall time')
+
+    return ranking
+
+
+if __name__ == '__main__':
+    args = argparse.ArgumentParser()
+
+    # tuner settings
+    args.add_argument('--agent', type=str, default='UCB', choices=list(SEARCH_SPACES))
+    args.add_argument('--eta', type=int, default=3)
+    args.add_argument('--hyperband', action=argparse.BooleanOptionalAction, default=False)
+    args.add_argument('--leaderboardPath', type=str, default='leaderboard.csv')
+    args.add_argument('--maxBudget', type=float, default=40.0)
+    args.add_argument('--mempoolKeyBase', type=int, default=5000)
+    args.add_argument('--minBudget', type=float, default=5.0)
+    args.add_argument('--minimize', action=argparse.BooleanOptionalAction, default=False)
+    args.add_argument('--nConfigs', type=int, default=27)
+    args.add_argument('--objective', type=str, default='throughput')
+    args.add_argument('--outDir', type=str, default='tuning')
+    args.add_argument('--seed', type=int, default=4)
+    args.add_argument('--tuneNCw', action=argparse.BooleanOptionalAction, default=True)
+    args.add_argument('--workers', type=int, default=os.cpu_count())
+
+    # scenario settings shared by all trials
+    args.add_argument('--cheaterNumber', type=int, default=1)
+    args.add_argument('--crnRun', type=int, default=-1)
+    args.add_argument('--nWifi', type=int, default=10)
+    args.add_argument('--ns3Path', type=str, default='')
+    args.add_argument('--scenario', type=str, default='scenario_mgr_multi_agent')
+
+    args = vars(args.parse_args())
+
+    rng = np.random.default_rng(args['seed'])
+    out_dir = os.path.abspath(args['outDir'])
+    os.makedirs(out_dir, exist_ok=True)
+    eta = args['eta']
+
+    trial_args = {
+        'common': {
+            'agent': args['agent'],
+            'minimize': args['minimize'],
+            'objective': args['objective'],
+            'outDir': out_dir,
+            'scenarioArgs': {
+                'agentName': args['agent'],
+                'cheaterNumber': args['cheaterNumber'],
+                'crnRun': args['crnRun'],
+                'nWifi': args['nWifi'],
+                'ns3Path': args['ns3Path'],
+                'scenario': args['scenario'],
+                'seed': args['seed']
+            }
+        },
+        'nextKey': args['mempoolKeyBase']
+    }
+
+    configs = {}
+    history = []
+
+    # brackets of (number of configurations, starting budget)
+    if args['hyperband']:
+        s_max = int(math.floor(math.log(args['maxBudget'] / args['minBudget'], eta) + 1e-9))
+        brackets = [(int(math.ceil((s_max + 1) / (s + 1) * eta ** s)), args['maxBudget'] * eta ** -s)
+                    for s in range(s_max, -1, -1)]
+    else:
+        brackets = [(args['nConfigs'], args['minBudget'])]
+
+    # a fresh process for every trial, so that no ns3-ai or JAX state leaks between them
+    with multiprocessing.get_context('spawn').Pool(args['workers'], maxtasksperchild=1) as pool:
+        for n_configs, min_budget in brackets:
+            bracket = {}
+            for _ in range(n_configs):
+                config_id = len(configs)
+                configs[config_id] = bracket[config_id] = sample_config(args['agent'], rng, args['tuneNCw'])
+
+            print(f'Bracket: {n_configs} configurations starting at {min_budget:g} s')
+            successive_halving(bracket, min_budget, args['maxBudget'], eta, pool, trial_args, history)
+
+    ranking = write_leaderboard(os.path.join(out_dir, args['leaderboardPath']), configs, history, args['minimize'])
+    best_id, best = ranking[0]
+    print(f'Best configuration: {configs[best_id]} ({args["objective"]} = {best["score"]} at {best["budget"]:g} s)')